@@ -0,0 +1,14 @@
+#version 430 core
+
+uniform sampler2D density;
+uniform vec4 color;
+
+in vec2 imageCoord;
+
+out vec4 outColor;
+
+void main(void) {
+	// tone mapped on the CPU already, the line color just gets faded in by it
+	float value = texture(density, imageCoord).r;
+	outColor = vec4(color.rgb, value);
+}
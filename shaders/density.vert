@@ -0,0 +1,12 @@
+#version 430 core
+
+// One triangle covering the window, no vertex data; the density image is laid over it as it is
+
+out vec2 imageCoord;
+
+void main(void) {
+	vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+	// the image's rows go top to bottom like the window's, texture rows bottom to top
+	imageCoord = vec2(corner.x, 1.0 - corner.y);
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
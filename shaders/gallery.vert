@@ -0,0 +1,39 @@
+#version 430 core
+
+uniform mat4 modelView;
+uniform mat4 ortho;
+uniform vec4 color;
+
+// shared by every curve in the gallery
+uniform int samples;
+uniform float thetaMax;
+uniform float cellSize;
+uniform float rotation;
+
+// per instance: outer radius, inner radius, cell center
+layout (location = 0) in vec4 curve;
+
+out vec4 fragColor;
+
+void main(void) {
+	float outerRadius = curve.x;
+	float innerRadius = curve.y;
+
+	// same hypocycloid as CurveGenerator::hypocycloidPoint, sampled by vertex index
+	float theta = thetaMax * float(gl_VertexID) / float(max(samples - 1, 1));
+	float radiusDif = outerRadius - innerRadius;
+	float ratio = ((radiusDif / innerRadius) / innerRadius) * theta;
+	vec2 p = vec2(
+		radiusDif * cos(theta) + innerRadius * cos(ratio),
+		radiusDif * sin(theta) - innerRadius * sin(ratio));
+
+	// rotate, then shrink the curve to fit inside its cell
+	float c = cos(rotation);
+	float s = sin(rotation);
+	p = mat2(c, s, -s, c) * p;
+	float extent = abs(radiusDif) + abs(innerRadius);
+	p = p * (0.45 * cellSize / max(extent, 1e-6)) + curve.zw;
+
+	fragColor = color;
+	gl_Position = ortho * modelView * vec4(p, 0.0, 1.0);
+}
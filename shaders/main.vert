@@ -4,7 +4,9 @@ uniform mat4 modelView;
 uniform mat4 ortho;
 uniform vec4 color;
 
-layout (location = 0) in vec3 vertex;
+layout (location = 0) in vec3 position;
+// per instance, how far this copy is turned about the local origin, already wrapped to [0, 2 pi), see RotatedCopies
+layout (location = 1) in float copyAngle;
 
 out vec4 fragColor;
 // out VertexData{
@@ -14,6 +16,7 @@ out vec4 fragColor;
 
 void main(void) {
 	// OutVertex.mColor = vec4(1.0f, 0.f, 0.f, 1.0f);
+	vec3 vertex = vec3(mat2(cos(copyAngle), sin(copyAngle), -sin(copyAngle), cos(copyAngle)) * position.xy, position.z);
 	float vNormal = sqrt(vertex.x*vertex.x + vertex.y*vertex.y);
     fragColor = vec4(color.x * color.w + (1-color.w) * (-vertex.x - vertex.y)/vNormal , color.y * color.w + (1-color.w) * vertex.x/vNormal, color.z * color.w + (1-color.w) * vertex.y/vNormal, color.w);
 	gl_Position = ortho * modelView * vec4(vertex, 1.0f);   
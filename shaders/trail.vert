@@ -0,0 +1,27 @@
+#version 430 core
+
+uniform mat4 modelView;
+uniform mat4 ortho;
+uniform vec4 color;
+
+// ring buffer of the most recent samples: head is the slot the next one goes to, filled how many are valid.
+// Slot capacity mirrors slot 0 so the strip stays connected across the wrap.
+uniform int head;
+uniform int capacity;
+uniform int filled;
+
+layout (location = 0) in vec3 vertex;
+
+out vec4 fragColor;
+
+void main(void) {
+	// gl_VertexID is the slot, draws start at their first vertex rather than 0
+	int slot = gl_VertexID % capacity;
+	int age = (head - 1 - slot + capacity) % capacity;
+	float fade = 1.0 - float(age) / float(max(filled, 1));
+
+	// same colouring as main.vert
+	float vNormal = sqrt(vertex.x*vertex.x + vertex.y*vertex.y);
+	fragColor = vec4(color.x * color.w + (1-color.w) * (-vertex.x - vertex.y)/vNormal, color.y * color.w + (1-color.w) * vertex.x/vNormal, color.z * color.w + (1-color.w) * vertex.y/vNormal, color.w * fade);
+	gl_Position = ortho * modelView * vec4(vertex, 1.0f);
+}
@@ -0,0 +1,204 @@
+#include "BatchRenderer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "VectorExporter.h"
+
+// Samples generated at a time; the whole curve is never held in memory
+static const size_t BATCH_CHUNK = 4096;
+
+// Half height of the on-screen view in world units, see RenderEngine::setWindowSize
+static const float VIEW_HALF_HEIGHT = 10.f;
+
+BatchRenderer::BatchRenderer(const BatchOptions& options) : options(options), pool(options.threads > 0 ? (int)options.threads - 1 : -1) {
+}
+
+bool BatchRenderer::parseRange(const char* text, float& min, float& max, int& count) {
+	char* end;
+	min = strtof(text, &end);
+	if (end == text) {
+		return false;
+	}
+	if (*end == '\0') {
+		max = min;
+		count = 1;
+		return true;
+	}
+	if (*end != ':') {
+		return false;
+	}
+	const char* next = end + 1;
+	max = strtof(next, &end);
+	if (end == next || *end != ':') {
+		return false;
+	}
+	count = (int)strtol(end + 1, &end, 10);
+	return *end == '\0' && count > 0;
+}
+
+std::vector<BatchJob> BatchRenderer::grid(float outerMin, float outerMax, int outerCount, float innerMin, float innerMax, int innerCount, const BatchJob& base) {
+	std::vector<BatchJob> jobs;
+	jobs.reserve((size_t)outerCount * innerCount);
+	for (int i = 0; i < outerCount; i++) {
+		for (int j = 0; j < innerCount; j++) {
+			BatchJob job = base;
+			job.params.outerRadius = outerCount > 1 ? glm::mix(outerMin, outerMax, (float)i / (float)(outerCount - 1)) : outerMin;
+			job.params.innerRadius = innerCount > 1 ? glm::mix(innerMin, innerMax, (float)j / (float)(innerCount - 1)) : innerMin;
+			jobs.push_back(job);
+		}
+	}
+	return jobs;
+}
+
+bool BatchRenderer::readList(const char* path, const BatchJob& base, std::vector<BatchJob>& jobs) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.resize(comment);
+		}
+
+		std::istringstream fields(line);
+		BatchJob job = base;
+		if (!(fields >> job.params.outerRadius)) {
+			continue; // blank line
+		}
+		if (!(fields >> job.params.innerRadius)) {
+			std::cerr << path << ":" << lineNumber << ": expected at least outer and inner radius" << std::endl;
+			return false;
+		}
+		// the remaining fields are optional
+		fields >> job.cycles >> job.params.step >> job.rotation >> job.scale;
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+size_t BatchRenderer::run(const std::vector<BatchJob>& jobs) {
+	std::atomic<size_t> failed(0);
+	pool.parallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			if (!render(jobs[i], i)) {
+				failed++;
+			}
+		}
+	});
+	return failed;
+}
+
+bool BatchRenderer::render(const BatchJob& job, size_t index) {
+	// world to pixel scale matching the on-screen view
+	float extent = std::fabs(job.params.outerRadius - job.params.innerRadius) + std::fabs(job.params.innerRadius);
+	float pixelsPerUnit = options.height / (2 * VIEW_HALF_HEIGHT);
+	if (options.fit) {
+		pixelsPerUnit = 0.95f * glm::min(options.width, options.height) / (2 * glm::max(extent * std::fabs(job.scale), 1e-6f));
+	}
+	if (options.format != BATCH_PGM) {
+		return exportVector(job, index, pixelsPerUnit);
+	}
+	if (options.density) {
+		// same mapping as below: scale, flip y, rotate, then move the origin to the image center
+		double angle = glm::radians((double)job.rotation);
+		double c = std::cos(angle) * pixelsPerUnit * job.scale;
+		double s = std::sin(angle) * pixelsPerUnit * job.scale;
+		glm::dmat3 toPixels = glm::dmat3(
+			c, -s, 0.0,
+			-s, -c, 0.0,
+			options.width * 0.5, options.height * 0.5, 1.0);
+		return renderDensity(job, index, toPixels);
+	}
+
+	// every pool thread keeps its own image and sample buffer between jobs
+	thread_local std::unique_ptr<Rasterizer> rasterizer;
+	thread_local std::vector<glm::vec3> samples;
+	if (!rasterizer || rasterizer->width() != options.width || rasterizer->height() != options.height) {
+		rasterizer.reset(new Rasterizer(options.width, options.height));
+	}
+	rasterizer->clear();
+	samples.resize(BATCH_CHUNK);
+
+	// world to pixel transform matching the on-screen model matrix (scale, then rotate)
+	float angle = glm::radians(job.rotation);
+	glm::mat2 rotate = glm::mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+	glm::mat2 toPixels = glm::mat2(pixelsPerUnit * job.scale, 0, 0, -pixelsPerUnit * job.scale) * rotate;
+	glm::vec2 center = glm::vec2(options.width, options.height) * 0.5f;
+
+	size_t total = CurveGenerator::hypocycloidSampleCount(job.params, job.cycles);
+	glm::vec2 previous;
+	for (size_t first = 0; first < total; first += BATCH_CHUNK) {
+		size_t count = glm::min(BATCH_CHUNK, total - first);
+		CurveGenerator::hypocycloid(job.params, first, count, samples.data());
+		for (size_t i = 0; i < count; i++) {
+			glm::vec2 p = toPixels * glm::vec2(samples[i]) + center;
+			if (first + i > 0) {
+				rasterizer->drawLine(previous, p);
+			}
+			previous = p;
+		}
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "/hypo_%06zu.pgm", index);
+	return rasterizer->writePGM((options.outputDirectory + path).c_str());
+}
+
+bool BatchRenderer::renderDensity(const BatchJob& job, size_t index, const glm::dmat3& toPixels) {
+	// each pool thread already runs a job of its own, so a map is binned on one thread and only read samples
+	// ever touch it
+	thread_local DensityMap density;
+	thread_local std::vector<uint8_t> image;
+	density.resize(options.width, options.height);
+	image.resize((size_t)options.width * options.height);
+
+	density.accumulate(job.params, toPixels, 0, CurveGenerator::hypocycloidSampleCount(job.params, job.cycles));
+	density.toneMap(options.exposure, image.data());
+
+	char path[64];
+	snprintf(path, sizeof(path), "/hypo_%06zu.pgm", index);
+	return Rasterizer::writePGM((options.outputDirectory + path).c_str(), options.width, options.height, image.data());
+}
+
+bool BatchRenderer::exportVector(const BatchJob& job, size_t index, float pixelsPerUnit) {
+	thread_local std::vector<glm::vec3> samples;
+	samples.resize(BATCH_CHUNK);
+
+	char path[64];
+	snprintf(path, sizeof(path), options.format == BATCH_SVG ? "/hypo_%06zu.svg" : "/hypo_%06zu.pdf", index);
+	glm::vec2 halfView = glm::vec2(options.width, options.height) * 0.5f / pixelsPerUnit;
+
+	VectorExporter exporter;
+	if (!exporter.begin((options.outputDirectory + path).c_str(), options.format == BATCH_SVG ? VectorExporter::SVG : VectorExporter::PDF,
+		options.width, options.height, -halfView, halfView)) {
+		return false;
+	}
+	glm::mat4 model = glm::mat4(1.f);
+	model = glm::scale(model, glm::vec3(job.scale, job.scale, 1.f));
+	model = glm::rotate(model, glm::radians(job.rotation), glm::vec3(0.f, 0.f, 1.f));
+	exporter.beginPath(model, glm::vec4(0.f, 0.f, 0.f, 1.f));
+
+	size_t total = CurveGenerator::hypocycloidSampleCount(job.params, job.cycles);
+	for (size_t first = 0; first < total; first += BATCH_CHUNK) {
+		size_t count = glm::min(BATCH_CHUNK, total - first);
+		CurveGenerator::hypocycloid(job.params, first, count, samples.data());
+		exporter.points(samples.data(), count);
+	}
+
+	exporter.endPath();
+	return exporter.end();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "CurveGenerator.h"
+#include "DensityMap.h"
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+
+// One curve of a batch run, with the same parameters as the UI panel
+struct BatchJob {
+	CurveParams params;
+	int cycles;
+	float rotation;
+	float scale;
+};
+
+enum BatchFormat {
+	BATCH_PGM,
+	BATCH_SVG,
+	BATCH_PDF
+};
+
+struct BatchOptions {
+	int width = 1024;
+	int height = 1024;
+	// scale every curve to fill the image instead of using the on-screen +-10 unit view
+	bool fit = false;
+	std::string outputDirectory = ".";
+	BatchFormat format = BATCH_PGM;
+	// PGM of how often the curve passes through each pixel instead of its lines, for very long curves
+	bool density = false;
+	float exposure = DensityMap::DEFAULT_EXPOSURE;
+	// 0 uses every core
+	unsigned int threads = 0;
+};
+
+// Renders many curves without any window system: each job is generated in chunks straight into a
+// CPU rasterizer owned by the pool thread running it, then written out as an image.
+// Vector formats stream the chunks into a VectorExporter instead.
+class BatchRenderer {
+
+public:
+	BatchRenderer(const BatchOptions& options);
+
+	// "min:max:count", or a single value for a count of one
+	static bool parseRange(const char* text, float& min, float& max, int& count);
+	// every combination of outer and inner radius, other parameters taken from base
+	static std::vector<BatchJob> grid(float outerMin, float outerMax, int outerCount, float innerMin, float innerMax, int innerCount, const BatchJob& base);
+	// one job per line: outerRadius innerRadius [cycles step rotation scale], '#' starts a comment
+	static bool readList(const char* path, const BatchJob& base, std::vector<BatchJob>& jobs);
+
+	// Returns how many jobs failed to render or write
+	size_t run(const std::vector<BatchJob>& jobs);
+
+private:
+	bool render(const BatchJob& job, size_t index);
+	bool renderDensity(const BatchJob& job, size_t index, const glm::dmat3& toPixels);
+	bool exportVector(const BatchJob& job, size_t index, float pixelsPerUnit);
+
+	BatchOptions options;
+	ThreadPool pool;
+};
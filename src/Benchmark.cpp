@@ -0,0 +1,110 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+Benchmark::Benchmark(const BenchmarkOptions& options) : options(options) {
+}
+
+void Benchmark::add(const std::string& name, size_t items, const std::function<void()>& body) {
+	if (name.find(options.filter) != std::string::npos) {
+		cases.push_back({ name, items, body });
+	}
+}
+
+const std::vector<BenchmarkResult>& Benchmark::run() {
+	typedef std::chrono::steady_clock Clock;
+
+	results.clear();
+	std::vector<double> times;
+	for (const Case& benchmarkCase : cases) {
+		for (int i = 0; i < options.warmup; i++) {
+			benchmarkCase.body();
+		}
+
+		times.clear();
+		double total = 0;
+		while ((int)times.size() < options.repetitions || total < options.minSeconds) {
+			Clock::time_point start = Clock::now();
+			benchmarkCase.body();
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			times.push_back(seconds);
+			total += seconds;
+		}
+		std::sort(times.begin(), times.end());
+
+		BenchmarkResult result;
+		result.name = benchmarkCase.name;
+		result.items = benchmarkCase.items;
+		result.repetitions = (int)times.size();
+		result.minSeconds = times.front();
+		result.medianSeconds = times[times.size() / 2];
+		result.p99Seconds = times[std::min(times.size() - 1, (times.size() * 99) / 100)];
+		result.itemsPerSecond = result.medianSeconds > 0 ? result.items / result.medianSeconds : 0;
+		results.push_back(result);
+
+		char line[256];
+		snprintf(line, sizeof(line), "%-36s %6d reps  median %10.3f us  p99 %10.3f us  %9.2f M items/s",
+			result.name.c_str(), result.repetitions, result.medianSeconds * 1e6, result.p99Seconds * 1e6, result.itemsPerSecond * 1e-6);
+		std::cout << line << std::endl;
+	}
+	return results;
+}
+
+void Benchmark::writeJSON(std::ostream& out) const {
+	out << "{\n  \"warmup\": " << options.warmup << ",\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& result = results[i];
+		char line[384];
+		snprintf(line, sizeof(line),
+			"    {\"name\": \"%s\", \"items\": %zu, \"repetitions\": %d, \"min_ns\": %.1f, \"median_ns\": %.1f, \"p99_ns\": %.1f, \"items_per_second\": %.1f}%s\n",
+			result.name.c_str(), result.items, result.repetitions, result.minSeconds * 1e9, result.medianSeconds * 1e9,
+			result.p99Seconds * 1e9, result.itemsPerSecond, i + 1 < results.size() ? "," : "");
+		out << line;
+	}
+	out << "  ]\n}\n";
+}
+
+bool Benchmark::readJSON(const char* path, std::vector<BenchmarkResult>& results) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		char name[128];
+		BenchmarkResult result;
+		double minNs, medianNs, p99Ns;
+		if (sscanf(line.c_str(), " {\"name\": \"%127[^\"]\", \"items\": %zu, \"repetitions\": %d, \"min_ns\": %lf, \"median_ns\": %lf, \"p99_ns\": %lf, \"items_per_second\": %lf",
+			name, &result.items, &result.repetitions, &minNs, &medianNs, &p99Ns, &result.itemsPerSecond) == 7) {
+			result.name = name;
+			result.minSeconds = minNs * 1e-9;
+			result.medianSeconds = medianNs * 1e-9;
+			result.p99Seconds = p99Ns * 1e-9;
+			results.push_back(result);
+		}
+	}
+	return true;
+}
+
+size_t Benchmark::compare(const std::vector<BenchmarkResult>& baseline, double threshold, std::ostream& out) const {
+	size_t regressions = 0;
+	for (const BenchmarkResult& result : results) {
+		auto old = std::find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult& b) { return b.name == result.name; });
+		if (old == baseline.end() || old->medianSeconds <= 0) {
+			continue;
+		}
+		double change = result.medianSeconds / old->medianSeconds - 1;
+		bool slower = change > threshold;
+		regressions += slower;
+
+		char line[256];
+		snprintf(line, sizeof(line), "%-36s %+7.1f%%%s", result.name.c_str(), change * 100, slower ? "  REGRESSION" : "");
+		out << line << std::endl;
+	}
+	return regressions;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+	std::string name;
+	// work done by one repetition, e.g. samples generated
+	size_t items;
+	int repetitions;
+	double minSeconds;
+	double medianSeconds;
+	double p99Seconds;
+	double itemsPerSecond;
+};
+
+struct BenchmarkOptions {
+	int warmup = 3;
+	int repetitions = 25;
+	// keep repeating until at least this much time was measured, so tiny cases aren't all timer noise
+	double minSeconds = 0.2;
+	// only run benchmarks whose name contains this
+	std::string filter;
+};
+
+// A minimal harness: every case gets a few untimed warmup runs, then is timed repeatedly and
+// summarized by its median and 99th percentile, which are stable enough to compare across commits.
+class Benchmark {
+
+public:
+	Benchmark(const BenchmarkOptions& options);
+
+	void add(const std::string& name, size_t items, const std::function<void()>& body);
+	const std::vector<BenchmarkResult>& run();
+
+	// One result per line, so baselines can be read back without a JSON library
+	void writeJSON(std::ostream& out) const;
+	static bool readJSON(const char* path, std::vector<BenchmarkResult>& results);
+	// Prints the median change against a baseline and returns how many cases got slower than threshold
+	size_t compare(const std::vector<BenchmarkResult>& baseline, double threshold, std::ostream& out) const;
+
+private:
+	struct Case {
+		std::string name;
+		size_t items;
+		std::function<void()> body;
+	};
+
+	BenchmarkOptions options;
+	std::vector<Case> cases;
+	std::vector<BenchmarkResult> results;
+};
@@ -0,0 +1,242 @@
+#include "CurveCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char CACHE_MAGIC[8] = { 'H', 'Y', 'P', 'O', 'C', 'R', 'V', '\0' };
+
+// numbers the temporaries of this process
+static std::atomic<unsigned int> temporaryCounter(0);
+
+static unsigned long processId() {
+#ifdef _WIN32
+	return (unsigned long)GetCurrentProcessId();
+#else
+	return (unsigned long)getpid();
+#endif
+}
+
+MappedCurve::~MappedCurve() {
+#ifdef _WIN32
+	if (base != nullptr) {
+		UnmapViewOfFile(base);
+	}
+	if (fileMapping != nullptr) {
+		CloseHandle(fileMapping);
+	}
+#else
+	if (base != nullptr) {
+		munmap((void*)base, size);
+	}
+#endif
+}
+
+CurveCache::CurveCache(const std::string& directory, uint64_t maxBytes) : directory(directory), maxBytes(maxBytes) {
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+}
+
+std::string CurveCache::path(const CurveParams& params) const {
+	// exact bit patterns, so two radii that print the same never share a file
+	uint32_t outer, inner;
+	memcpy(&outer, &params.outerRadius, sizeof(outer));
+	memcpy(&inner, &params.innerRadius, sizeof(inner));
+	char name[64];
+	snprintf(name, sizeof(name), "/hypo_%08x_%08x_%d.curve", outer, inner, params.step);
+	return directory + name;
+}
+
+std::unique_ptr<MappedCurve> CurveCache::load(const CurveParams& params) const {
+	std::string file = path(params);
+	std::unique_ptr<MappedCurve> mapped(new MappedCurve());
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(CurveCacheHeader)) {
+		CloseHandle(handle);
+		return nullptr;
+	}
+	mapped->size = (size_t)fileSize.QuadPart;
+	mapped->fileMapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(handle);
+	if (mapped->fileMapping == nullptr) {
+		return nullptr;
+	}
+	mapped->base = (const char*)MapViewOfFile(mapped->fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapped->base == nullptr) {
+		return nullptr;
+	}
+#else
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(CurveCacheHeader)) {
+		close(fd);
+		return nullptr;
+	}
+	mapped->size = (size_t)info.st_size;
+	void* base = mmap(nullptr, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return nullptr;
+	}
+	mapped->base = (const char*)base;
+#endif
+
+	// anything that doesn't match exactly is treated as a miss and gets overwritten later
+	const CurveCacheHeader& header = mapped->header();
+	bool valid = memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+		&& header.version == VERSION
+		&& header.vertexFormat == VERTEX_FORMAT_XYZ_F32
+		&& header.vertexStride == sizeof(glm::vec3)
+		&& header.outerRadius == params.outerRadius
+		&& header.innerRadius == params.innerRadius
+		&& header.step == params.step
+		&& header.payloadOffset >= sizeof(CurveCacheHeader)
+		&& header.payloadOffset % PAYLOAD_ALIGNMENT == 0
+		&& header.payloadOffset <= mapped->size
+		&& header.sampleCount <= (mapped->size - header.payloadOffset) / sizeof(glm::vec3);
+	if (!valid) {
+		return nullptr;
+	}
+	// the modification time doubles as the last use, see evict
+	std::error_code error;
+	std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), error);
+	return mapped;
+}
+
+bool CurveCache::store(const CurveParams& params, size_t count, const SampleSource& source) const {
+	CurveCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = VERSION;
+	header.vertexFormat = VERTEX_FORMAT_XYZ_F32;
+	header.vertexStride = sizeof(glm::vec3);
+	header.outerRadius = params.outerRadius;
+	header.innerRadius = params.innerRadius;
+	header.step = params.step;
+	header.sampleCount = count;
+	header.payloadOffset = (sizeof(CurveCacheHeader) + PAYLOAD_ALIGNMENT - 1) / PAYLOAD_ALIGNMENT * PAYLOAD_ALIGNMENT;
+
+	std::string file = path(params);
+	std::string temporary = file + "." + std::to_string(processId()) + "_" + std::to_string(temporaryCounter++) + ".tmp";
+	FILE* out = fopen(temporary.c_str(), "wb");
+	if (out == nullptr) {
+		return false;
+	}
+
+	// the header goes in last, once the bounds are known
+	char padding[PAYLOAD_ALIGNMENT] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1
+		&& fwrite(padding, 1, header.payloadOffset - sizeof(header), out) == header.payloadOffset - sizeof(header);
+	bool abandoned = false;
+	std::vector<glm::vec3> block(glm::min(count, STORE_BLOCK));
+	glm::vec2 boundsMin = glm::vec2(0.f);
+	glm::vec2 boundsMax = glm::vec2(0.f);
+	for (size_t first = 0; ok && first < count; first += block.size()) {
+		size_t blockCount = glm::min(block.size(), count - first);
+		if (!source(first, blockCount, block.data())) {
+			abandoned = true;
+			break;
+		}
+		if (first == 0) {
+			boundsMin = boundsMax = glm::vec2(block[0]);
+		}
+		for (size_t i = 0; i < blockCount; i++) {
+			boundsMin = glm::min(boundsMin, glm::vec2(block[i]));
+			boundsMax = glm::max(boundsMax, glm::vec2(block[i]));
+		}
+		ok = fwrite(block.data(), sizeof(glm::vec3), blockCount, out) == blockCount;
+	}
+	header.boundsMin[0] = boundsMin.x;
+	header.boundsMin[1] = boundsMin.y;
+	header.boundsMax[0] = boundsMax.x;
+	header.boundsMax[1] = boundsMax.y;
+	ok = ok && !abandoned && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+	ok = fclose(out) == 0 && ok;
+
+	std::error_code error;
+	if (ok) {
+		std::filesystem::rename(temporary, file, error);
+		ok = !error;
+	}
+	if (!ok) {
+		if (!abandoned) {
+			std::cerr << "Could not write curve cache " << file << std::endl;
+		}
+		std::filesystem::remove(temporary, error);
+	}
+	else {
+		evict(file);
+	}
+	return ok;
+}
+
+void CurveCache::evict(const std::string& keep) const {
+	struct Entry {
+		std::filesystem::file_time_type used;
+		uint64_t size;
+		std::filesystem::path path;
+	};
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+	std::filesystem::file_time_type now = std::filesystem::file_time_type::clock::now();
+	std::filesystem::path kept = std::filesystem::path(keep).filename();
+
+	std::error_code error;
+	for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+		std::error_code entryError;
+		Entry entry;
+		entry.path = it->path();
+		entry.size = it->file_size(entryError);
+		entry.used = it->last_write_time(entryError);
+		if (entryError) {
+			continue;
+		}
+		if (entry.path.extension() == ".tmp") {
+			if (now - entry.used > std::chrono::hours(STALE_TEMPORARY_HOURS)) {
+				std::filesystem::remove(entry.path, entryError);
+			}
+			continue;
+		}
+		if (entry.path.extension() != ".curve") {
+			continue;
+		}
+		total += entry.size;
+		if (entry.path.filename() != kept) {
+			entries.push_back(entry);
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+	for (size_t i = 0; i < entries.size() && total > maxBytes; i++) {
+		// a file another process still has mapped can't always be deleted, it goes on a later store
+		std::error_code removeError;
+		if (std::filesystem::remove(entries[i].path, removeError)) {
+			total -= entries[i].size;
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "CurveGenerator.h"
+
+// On-disk layout of a cached curve. Everything is little endian and the vertex payload starts at
+// payloadOffset, aligned so a mapping of the file can be handed to glBufferData as is.
+struct CurveCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t vertexFormat;
+	uint32_t vertexStride;
+	float outerRadius;
+	float innerRadius;
+	int32_t step;
+	uint64_t sampleCount;
+	float boundsMin[2];
+	float boundsMax[2];
+	uint64_t payloadOffset;
+};
+
+// A read-only memory mapping of one cache file, unmapped when destroyed
+class MappedCurve {
+
+public:
+	~MappedCurve();
+
+	const CurveCacheHeader& header() const { return *(const CurveCacheHeader*)base; }
+	const glm::vec3* vertices() const { return (const glm::vec3*)(base + header().payloadOffset); }
+	size_t count() const { return (size_t)header().sampleCount; }
+
+private:
+	friend class CurveCache;
+	MappedCurve() = default;
+
+	const char* base = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileMapping = nullptr;
+#endif
+};
+
+// Keeps generated hypocycloids between runs.
+// Samples only depend on the parameters and their index, so one file per (outer radius, inner radius, step)
+// holds a prefix that serves any number of cycles up to what was stored.
+// The directory is kept under maxBytes by deleting the files that were used longest ago.
+class CurveCache {
+
+public:
+	static const uint32_t VERSION = 1;
+	static const uint32_t VERTEX_FORMAT_XYZ_F32 = 1;
+	static const size_t PAYLOAD_ALIGNMENT = 64;
+	// about 180 curves of a million samples
+	static const uint64_t DEFAULT_MAX_BYTES = 2ull << 30;
+	// samples handed to a SampleSource at a time
+	static const size_t STORE_BLOCK = 1 << 20;
+
+	// Fills out with count samples starting at sample first, or returns false to abandon the store
+	typedef std::function<bool(size_t first, size_t count, glm::vec3* out)> SampleSource;
+
+	CurveCache(const std::string& directory, uint64_t maxBytes = DEFAULT_MAX_BYTES);
+
+	// nullptr if nothing valid is cached for these parameters, a hit counts as a use for eviction
+	std::unique_ptr<MappedCurve> load(const CurveParams& params) const;
+	// Writes count samples taken from source a block at a time to a temporary file and renames it over the old
+	// one, so readers never see a partial file. The name of the temporary is unique to this process and call,
+	// so concurrent writers don't collide.
+	bool store(const CurveParams& params, size_t count, const SampleSource& source) const;
+
+private:
+	// temporaries this old were left behind by a writer that didn't finish
+	static constexpr int STALE_TEMPORARY_HOURS = 1;
+
+	std::string path(const CurveParams& params) const;
+	// deletes the least recently used curves until the directory fits maxBytes again, never the one named keep
+	void evict(const std::string& keep) const;
+
+	std::string directory;
+	uint64_t maxBytes;
+};
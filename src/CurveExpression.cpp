@@ -0,0 +1,465 @@
+#include "CurveExpression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "CurveGenerator.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+static const double PI = 3.14159265358979323846264338327950288;
+
+static const char* const OPCODE_NAMES[CurveExpression::OP_COUNT] = {
+	"t", "constant", "parameter", "-", "+", "-", "*", "/", "^",
+	"sin", "cos", "tan", "asin", "acos", "atan", "exp", "log", "sqrt", "abs", "floor",
+	"atan2", "min", "max"
+};
+
+const char* CurveExpression::opcodeName(Opcode op) {
+	return OPCODE_NAMES[op];
+}
+
+int CurveExpression::operandCount(Opcode op) {
+	if (op <= OP_PARAMETER) {
+		return 0;
+	}
+	if (op == OP_NEGATE || (op >= OP_SIN && op <= OP_FLOOR)) {
+		return 1;
+	}
+	return 2;
+}
+
+template <typename F>
+static void lanes(float* d, const float* a, const float* b, F f) {
+	for (size_t l = 0; l < CurveExpression::BATCH; l++) {
+		d[l] = f(a[l], b[l]);
+	}
+}
+
+// One arithmetic or function instruction over a batch. Constant folding goes through here too, so a folded
+// expression gives exactly what the interpreter would.
+static void execute(CurveExpression::Opcode op, float* d, const float* a, const float* b) {
+	switch (op) {
+	case CurveExpression::OP_NEGATE: lanes(d, a, b, [](float x, float) { return -x; }); break;
+	case CurveExpression::OP_ADD: lanes(d, a, b, [](float x, float y) { return x + y; }); break;
+	case CurveExpression::OP_SUBTRACT: lanes(d, a, b, [](float x, float y) { return x - y; }); break;
+	case CurveExpression::OP_MULTIPLY: lanes(d, a, b, [](float x, float y) { return x * y; }); break;
+	case CurveExpression::OP_DIVIDE: lanes(d, a, b, [](float x, float y) { return x / y; }); break;
+	case CurveExpression::OP_POWER: lanes(d, a, b, [](float x, float y) { return std::pow(x, y); }); break;
+	case CurveExpression::OP_SIN: lanes(d, a, b, [](float x, float) { return std::sin(x); }); break;
+	case CurveExpression::OP_COS: lanes(d, a, b, [](float x, float) { return std::cos(x); }); break;
+	case CurveExpression::OP_TAN: lanes(d, a, b, [](float x, float) { return std::tan(x); }); break;
+	case CurveExpression::OP_ASIN: lanes(d, a, b, [](float x, float) { return std::asin(x); }); break;
+	case CurveExpression::OP_ACOS: lanes(d, a, b, [](float x, float) { return std::acos(x); }); break;
+	case CurveExpression::OP_ATAN: lanes(d, a, b, [](float x, float) { return std::atan(x); }); break;
+	case CurveExpression::OP_EXP: lanes(d, a, b, [](float x, float) { return std::exp(x); }); break;
+	case CurveExpression::OP_LOG: lanes(d, a, b, [](float x, float) { return std::log(x); }); break;
+	case CurveExpression::OP_SQRT: lanes(d, a, b, [](float x, float) { return std::sqrt(x); }); break;
+	case CurveExpression::OP_ABS: lanes(d, a, b, [](float x, float) { return std::fabs(x); }); break;
+	case CurveExpression::OP_FLOOR: lanes(d, a, b, [](float x, float) { return std::floor(x); }); break;
+	case CurveExpression::OP_ATAN2: lanes(d, a, b, [](float x, float y) { return std::atan2(x, y); }); break;
+	case CurveExpression::OP_MIN: lanes(d, a, b, [](float x, float y) { return y < x ? y : x; }); break;
+	case CurveExpression::OP_MAX: lanes(d, a, b, [](float x, float y) { return x < y ? y : x; }); break;
+	default: break;
+	}
+}
+
+// Recursive descent over
+//   sum     = product { ("+" | "-") product }
+//   product = unary { ("*" | "/") unary }
+//   unary   = ("-" | "+") unary | power
+//   power   = primary [ "^" unary ]
+//   primary = number | name | name "(" sum { "," sum } ")" | "(" sum ")"
+// so -x^2 is -(x^2) and 2^3^2 is 2^(3^2), as usual.
+class CurveExpression::Parser {
+
+public:
+	Parser(const std::string& text, std::vector<Node>& nodes, std::vector<std::string>& names)
+		: text(text), nodes(nodes), names(names) {
+	}
+
+	bool parse(int& root, std::string& error) {
+		root = sum();
+		skipSpace();
+		if (root >= 0 && position < text.size()) {
+			root = fail("unexpected character");
+		}
+		if (root < 0) {
+			error = failure;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	int sum() {
+		int node = product();
+		while (node >= 0) {
+			if (accept('+')) {
+				node = add(OP_ADD, node, product());
+			}
+			else if (accept('-')) {
+				node = add(OP_SUBTRACT, node, product());
+			}
+			else {
+				break;
+			}
+		}
+		return node;
+	}
+
+	int product() {
+		int node = unary();
+		while (node >= 0) {
+			if (accept('*')) {
+				node = add(OP_MULTIPLY, node, unary());
+			}
+			else if (accept('/')) {
+				node = add(OP_DIVIDE, node, unary());
+			}
+			else {
+				break;
+			}
+		}
+		return node;
+	}
+
+	int unary() {
+		if (accept('-')) {
+			return add(OP_NEGATE, unary());
+		}
+		if (accept('+')) {
+			return unary();
+		}
+		return power();
+	}
+
+	int power() {
+		int node = primary();
+		if (node >= 0 && accept('^')) {
+			node = add(OP_POWER, node, unary());
+		}
+		return node;
+	}
+
+	int primary() {
+		skipSpace();
+		if (position >= text.size()) {
+			return fail("expression ends early");
+		}
+		char c = text[position];
+		if (accept('(')) {
+			int node = sum();
+			if (node >= 0 && !accept(')')) {
+				return fail("missing )");
+			}
+			return node;
+		}
+		if (std::isdigit((unsigned char)c) || c == '.') {
+			const char* start = text.c_str() + position;
+			char* end;
+			double value = std::strtod(start, &end);
+			if (end == start) {
+				return fail("bad number");
+			}
+			position += end - start;
+			return constant((float)value);
+		}
+		if (!std::isalpha((unsigned char)c) && c != '_') {
+			return fail("unexpected character");
+		}
+
+		size_t start = position;
+		while (position < text.size() && (std::isalnum((unsigned char)text[position]) || text[position] == '_')) {
+			position++;
+		}
+		std::string name = text.substr(start, position - start);
+		if (accept('(')) {
+			return call(name, start);
+		}
+		if (name == "t") {
+			return add(OP_T);
+		}
+		if (name == "pi") {
+			return constant((float)PI);
+		}
+		if (name == "e") {
+			return constant((float)std::exp(1.0));
+		}
+		size_t index = 0;
+		while (index < names.size() && names[index] != name) {
+			index++;
+		}
+		if (index == names.size()) {
+			if (names.size() == MAX_PARAMETERS) {
+				position = start;
+				return fail("too many parameters");
+			}
+			names.push_back(name);
+		}
+		Node node = { OP_PARAMETER, (int)index, -1, 0.f };
+		nodes.push_back(node);
+		return (int)nodes.size() - 1;
+	}
+
+	// the opening parenthesis has been read
+	int call(const std::string& name, size_t start) {
+		Opcode op = OP_SIN;
+		while (op < OP_COUNT && name != opcodeName(op)) {
+			op = (Opcode)(op + 1);
+		}
+		if (op == OP_COUNT) {
+			position = start;
+			return fail("unknown function");
+		}
+		int operands[2] = { -1, -1 };
+		for (int i = 0; i < operandCount(op); i++) {
+			if (i > 0 && !accept(',')) {
+				return fail("missing argument");
+			}
+			operands[i] = sum();
+			if (operands[i] < 0) {
+				return -1;
+			}
+		}
+		if (!accept(')')) {
+			return fail("missing )");
+		}
+		return add(op, operands[0], operands[1]);
+	}
+
+	int constant(float value) {
+		Node node = { OP_CONSTANT, -1, -1, value };
+		nodes.push_back(node);
+		return (int)nodes.size() - 1;
+	}
+
+	// -1 operands pass a failure further up
+	int add(Opcode op, int a = -1, int b = -1) {
+		int operands = operandCount(op);
+		if ((operands >= 1 && a < 0) || (operands == 2 && b < 0)) {
+			return -1;
+		}
+		Node node = { op, a, b, 0.f };
+		nodes.push_back(node);
+		return (int)nodes.size() - 1;
+	}
+
+	int fail(const char* what) {
+		// the innermost failure is the one that says where things went wrong
+		if (failure.empty()) {
+			failure = std::string(what) + " at column " + std::to_string(position + 1);
+		}
+		return -1;
+	}
+
+	void skipSpace() {
+		while (position < text.size() && std::isspace((unsigned char)text[position])) {
+			position++;
+		}
+	}
+
+	bool accept(char c) {
+		skipSpace();
+		if (position < text.size() && text[position] == c) {
+			position++;
+			return true;
+		}
+		return false;
+	}
+
+	const std::string& text;
+	std::vector<Node>& nodes;
+	std::vector<std::string>& names;
+	size_t position = 0;
+	std::string failure;
+};
+
+bool CurveExpression::compile(const std::string& x, const std::string& y) {
+	std::vector<Node> nodes;
+	std::vector<std::string> newNames;
+	const std::string* texts[2] = { &x, &y };
+	int roots[2];
+	for (int c = 0; c < 2; c++) {
+		Parser parser(*texts[c], nodes, newNames);
+		std::string error;
+		if (!parser.parse(roots[c], error)) {
+			message = (c == 0 ? "x: " : "y: ") + error;
+			return false;
+		}
+		roots[c] = fold(nodes, roots[c]);
+	}
+
+	// x is kept in register 0 while y is worked out from register 1 up
+	std::vector<Instruction> newCode;
+	size_t used = 0;
+	if (!emit(nodes, roots[0], 0, newCode, used) || !emit(nodes, roots[1], 1, newCode, used)) {
+		message = "expression nests too deeply";
+		return false;
+	}
+	code.swap(newCode);
+	names.swap(newNames);
+	registers = used;
+	message.clear();
+	return true;
+}
+
+int CurveExpression::fold(std::vector<Node>& nodes, int node) {
+	int operands = operandCount(nodes[node].op);
+	if (operands == 0) {
+		return node;
+	}
+	bool constant = true;
+	for (int i = 0; i < operands; i++) {
+		int& operand = i == 0 ? nodes[node].a : nodes[node].b;
+		operand = fold(nodes, operand);
+		constant = constant && nodes[operand].op == OP_CONSTANT;
+	}
+	if (constant) {
+		float a[BATCH], b[BATCH], result[BATCH];
+		std::fill(a, a + BATCH, nodes[nodes[node].a].value);
+		std::fill(b, b + BATCH, operands == 2 ? nodes[nodes[node].b].value : 0.f);
+		execute(nodes[node].op, result, a, b);
+		nodes[node] = { OP_CONSTANT, -1, -1, result[0] };
+	}
+	return node;
+}
+
+bool CurveExpression::emit(const std::vector<Node>& nodes, int node, size_t dst, std::vector<Instruction>& out, size_t& used) {
+	if (dst >= MAX_REGISTERS) {
+		return false;
+	}
+	used = glm::max(used, dst + 1);
+	const Node& n = nodes[node];
+	Instruction instruction = { n.op, (uint8_t)dst, 0, 0, n.value };
+	int operands = operandCount(n.op);
+	if (n.op == OP_PARAMETER) {
+		instruction.a = (uint8_t)n.a;
+	}
+	if (operands >= 1) {
+		if (!emit(nodes, n.a, dst, out, used)) {
+			return false;
+		}
+		instruction.a = (uint8_t)dst;
+	}
+	if (operands == 2) {
+		if (!emit(nodes, n.b, dst + 1, out, used)) {
+			return false;
+		}
+		instruction.b = (uint8_t)(dst + 1);
+	}
+	out.push_back(instruction);
+	return true;
+}
+
+// A float literal GLSL reads back as exactly value
+static std::string glslFloat(float value) {
+	char text[48];
+	if (!std::isfinite(value)) {
+		// there is no literal for these, e.g. a constant folded from 1 / 0
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		std::snprintf(text, sizeof(text), "uintBitsToFloat(0x%08xu)", bits);
+	}
+	else {
+		// 9 significant digits round trip any float, and the exponent form always parses as a float
+		std::snprintf(text, sizeof(text), value < 0 ? "(%.8e)" : "%.8e", value);
+	}
+	return text;
+}
+
+std::string CurveExpression::glsl() const {
+	std::string source = "vec2 curve(float t) {\n";
+	if (code.empty()) {
+		return source + "\treturn vec2(0.0);\n}\n";
+	}
+	source += "\tfloat r0";
+	for (size_t r = 1; r < registers; r++) {
+		source += ", r" + std::to_string(r);
+	}
+	source += ";\n";
+
+	for (const Instruction& instruction : code) {
+		std::string a = "r" + std::to_string(instruction.a);
+		std::string b = "r" + std::to_string(instruction.b);
+		std::string value;
+		switch (instruction.op) {
+		case OP_T: value = "t"; break;
+		case OP_CONSTANT: value = glslFloat(instruction.value); break;
+		case OP_PARAMETER: value = "parameters[" + std::to_string(instruction.a) + "]"; break;
+		case OP_NEGATE: value = "-" + a; break;
+		case OP_ADD: value = a + " + " + b; break;
+		case OP_SUBTRACT: value = a + " - " + b; break;
+		case OP_MULTIPLY: value = a + " * " + b; break;
+		case OP_DIVIDE: value = a + " / " + b; break;
+		case OP_POWER: value = "power(" + a + ", " + b + ")"; break;
+		// GLSL's two-argument atan is atan2
+		case OP_ATAN2: value = "atan(" + a + ", " + b + ")"; break;
+		case OP_MIN:
+		case OP_MAX: value = std::string(opcodeName(instruction.op)) + "(" + a + ", " + b + ")"; break;
+		default: value = std::string(opcodeName(instruction.op)) + "(" + a + ")"; break;
+		}
+		source += "\tr" + std::to_string(instruction.dst) + " = " + value + ";\n";
+	}
+	return source + "\treturn vec2(r0, r1);\n}\n";
+}
+
+uint64_t CurveExpression::hash() const {
+	uint64_t hash = 14695981039346656037ULL;
+	for (const Instruction& instruction : code) {
+		// field by field, the struct's padding is uninitialized
+		unsigned char bytes[8] = { (unsigned char)instruction.op, instruction.dst, instruction.a, instruction.b };
+		std::memcpy(bytes + 4, &instruction.value, sizeof(float));
+		for (unsigned char byte : bytes) {
+			hash = (hash ^ byte) * 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+void CurveExpression::evaluate(const float* parameters, double t0, double dt, size_t first, size_t count, glm::vec3* out) const {
+	if (code.empty()) {
+		std::fill(out, out + count, glm::vec3(0.f));
+		return;
+	}
+	float r[MAX_REGISTERS][BATCH];
+	float t[BATCH];
+	for (size_t done = 0; done < count; done += BATCH) {
+		size_t n = glm::min(BATCH, count - done);
+		// t in double until here, so samples far from t0 land where they should
+		for (size_t l = 0; l < BATCH; l++) {
+			t[l] = (float)(t0 + (double)(first + done + l) * dt);
+		}
+		for (const Instruction& instruction : code) {
+			float* d = r[instruction.dst];
+			switch (instruction.op) {
+			case OP_T:
+				std::copy(t, t + BATCH, d);
+				break;
+			case OP_CONSTANT:
+				std::fill(d, d + BATCH, instruction.value);
+				break;
+			case OP_PARAMETER:
+				std::fill(d, d + BATCH, parameters[instruction.a]);
+				break;
+			default:
+				execute(instruction.op, d, r[instruction.a], r[instruction.b]);
+				break;
+			}
+		}
+		for (size_t l = 0; l < n; l++) {
+			out[done + l] = glm::vec3(r[0][l], r[1][l], 0.f);
+		}
+	}
+}
+
+void CurveExpression::evaluate(ThreadPool& pool, const float* parameters, double t0, double dt, size_t count, glm::vec3* out) const {
+	PROFILE_ZONE("evaluateExpression");
+	pool.parallelFor(count, CurveGenerator::CHUNK_SIZE, [&](size_t begin, size_t end) {
+		evaluate(parameters, t0, dt, begin, end - begin, out + begin);
+	});
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// A user-defined parametric curve x(t), y(t), compiled to register bytecode.
+// The expressions use + - * / ^, parentheses, the functions below, the constants pi and e, and t. Any other name
+// is a parameter whose value is passed in when evaluating, so changing one never needs a recompile.
+// The interpreter runs each instruction over BATCH samples at once, which spreads the cost of decoding it and
+// turns the arithmetic into loops the compiler vectorizes.
+class CurveExpression {
+
+public:
+	// samples every instruction runs over at a time
+	static const size_t BATCH = 16;
+	// registers available to intermediate results, which limits how deeply an expression can nest
+	static const size_t MAX_REGISTERS = 32;
+	static const size_t MAX_PARAMETERS = 32;
+
+	enum Opcode : uint8_t {
+		OP_T,
+		OP_CONSTANT,
+		OP_PARAMETER,
+		OP_NEGATE,
+		OP_ADD,
+		OP_SUBTRACT,
+		OP_MULTIPLY,
+		OP_DIVIDE,
+		OP_POWER,
+		OP_SIN,
+		OP_COS,
+		OP_TAN,
+		OP_ASIN,
+		OP_ACOS,
+		OP_ATAN,
+		OP_EXP,
+		OP_LOG,
+		OP_SQRT,
+		OP_ABS,
+		OP_FLOOR,
+		OP_ATAN2,
+		OP_MIN,
+		OP_MAX,
+		OP_COUNT
+	};
+
+	// dst = op(a, b); constants keep their value in value and parameters their index in a
+	struct Instruction {
+		Opcode op;
+		uint8_t dst;
+		uint8_t a;
+		uint8_t b;
+		float value;
+	};
+
+	// the name an opcode has in expressions, and how many operands it takes
+	static const char* opcodeName(Opcode op);
+	static int operandCount(Opcode op);
+
+	// Parses and compiles both coordinates. On failure the previous program is kept and error() says what is
+	// wrong and where.
+	bool compile(const std::string& x, const std::string& y);
+	const std::string& error() const { return message; }
+	bool empty() const { return code.empty(); }
+
+	// in order of first appearance, x before y
+	const std::vector<std::string>& parameterNames() const { return names; }
+	const std::vector<Instruction>& instructions() const { return code; }
+	// registers the program uses; x ends up in register 0 and y in register 1
+	size_t registerCount() const { return registers; }
+
+	// GLSL definition of vec2 curve(float t), one local per register assigned in the same order the interpreter
+	// runs them. It reads parameters from a uniform float parameters[] and calls power() for ^, which the shader
+	// it is compiled into has to provide, see shaders/expression.comp.
+	std::string glsl() const;
+	// FNV-1a over the bytecode, so expressions that only differ in spacing or folded constants share a shader
+	uint64_t hash() const;
+
+	// Fills out[0, count) with the curve at t = t0 + (first + i) * dt, parameters indexed like parameterNames()
+	void evaluate(const float* parameters, double t0, double dt, size_t first, size_t count, glm::vec3* out) const;
+	// The same split across the pool
+	void evaluate(ThreadPool& pool, const float* parameters, double t0, double dt, size_t count, glm::vec3* out) const;
+
+private:
+	struct Node {
+		Opcode op;
+		// operands as node indices, or the parameter index for OP_PARAMETER
+		int a;
+		int b;
+		float value;
+	};
+
+	class Parser;
+
+	// replaces operations on constants with their result
+	static int fold(std::vector<Node>& nodes, int node);
+	// emits node into register dst, using only registers from dst up for temporaries
+	static bool emit(const std::vector<Node>& nodes, int node, size_t dst, std::vector<Instruction>& out, size_t& used);
+
+	std::vector<Instruction> code;
+	std::vector<std::string> names;
+	size_t registers = 0;
+	std::string message;
+};
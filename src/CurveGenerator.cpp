@@ -0,0 +1,193 @@
+#include "CurveGenerator.h"
+
+#include <cmath>
+
+#include "ThreadPool.h"
+
+static const double PI = 3.14159265358979323846264338327950288;
+
+glm::vec3 CurveGenerator::hypocycloidPoint(const CurveParams& params, float theta) {
+	float radiusDif = (params.outerRadius - params.innerRadius);
+	float ratio = ((radiusDif / params.innerRadius) / params.innerRadius) * theta;
+	return glm::vec3(
+		(radiusDif*cos(theta) + params.innerRadius * cos(ratio)),
+		(radiusDif*sin(theta) - params.innerRadius * sin(ratio)),
+		0.f);
+}
+
+float CurveGenerator::hypocycloidTheta(const CurveParams& params, size_t index) {
+	return (float)((double)index / (double)params.step);
+}
+
+size_t CurveGenerator::hypocycloidSampleCount(const CurveParams& params, int cycles) {
+	return (size_t)std::ceil(PI * 2 * cycles * params.step) + 1;
+}
+
+// x wrapped into [0, 2pi), in double so large angles keep their fraction of a turn
+static double wrapAngle(double x) {
+	return x - 2 * PI * std::floor(x / (2 * PI));
+}
+
+void CurveGenerator::hypocycloid(const CurveParams& params, size_t first, size_t count, glm::vec3* out) {
+	// same point as hypocycloidPoint, but both angles are wrapped to one turn before dropping to float,
+	// so samples thousands of turns along are as precise as the first ones
+	float radiusDif = (params.outerRadius - params.innerRadius);
+	double rate = (((double)params.outerRadius - params.innerRadius) / params.innerRadius) / params.innerRadius;
+	for (size_t i = 0; i < count; i++) {
+		double theta = (double)(first + i) / (double)params.step;
+		float outer = (float)wrapAngle(theta);
+		float inner = (float)wrapAngle(rate * theta);
+		out[i] = glm::vec3(
+			(radiusDif*std::cos(outer) + params.innerRadius * std::cos(inner)),
+			(radiusDif*std::sin(outer) - params.innerRadius * std::sin(inner)),
+			0.f);
+	}
+}
+
+// |1 + (R - r) / r^2|: P(theta + a) = e^(ia) P(theta) exactly when this times a is a whole number of turns
+static double arcTurns(const CurveParams& params) {
+	double rate = (((double)params.outerRadius - params.innerRadius) / params.innerRadius) / params.innerRadius;
+	return std::fabs(1.0 + rate);
+}
+
+double CurveGenerator::hypocycloidArcAngle(const CurveParams& params) {
+	double turns = arcTurns(params);
+	return turns > 1e-12 ? 2 * PI / turns : 0.0;
+}
+
+bool CurveGenerator::hypocycloidSymmetry(const CurveParams& params, int maxCycles, int& order, int& cycles) {
+	// the convergents p / q of the turns' continued fraction; the curve closes after q cycles made of p arcs
+	double x = arcTurns(params);
+	double p = 1, previousP = 0;
+	double q = 0, previousQ = 1;
+	double f = x;
+	for (int n = 0; n < 64; n++) {
+		double a = std::floor(f);
+		double nextP = a * p + previousP;
+		double nextQ = a * q + previousQ;
+		if (nextQ > maxCycles) {
+			break;
+		}
+		previousP = p;
+		previousQ = q;
+		p = nextP;
+		q = nextQ;
+		// the radii are floats, so only ask for about float precision
+		if (p >= 1 && std::fabs(x - p / q) <= 1e-6 * glm::max(x, 1.0)) {
+			order = (int)p;
+			cycles = (int)q;
+			return true;
+		}
+		double fraction = f - a;
+		if (fraction < 1e-12) {
+			break;
+		}
+		f = 1 / fraction;
+	}
+	return false;
+}
+
+glm::dvec2 CurveGenerator::hypocycloidPointPrecise(const CurveParams& params, double theta) {
+	double radiusDif = ((double)params.outerRadius - params.innerRadius);
+	double ratio = ((radiusDif / params.innerRadius) / params.innerRadius) * theta;
+	return glm::dvec2(
+		(radiusDif*cos(theta) + params.innerRadius * cos(ratio)),
+		(radiusDif*sin(theta) - params.innerRadius * sin(ratio)));
+}
+
+double CurveGenerator::hypocycloidSpeed(const CurveParams& params) {
+	// (R - r) from the rolling centre plus r times the rim's angular rate (R - r) / r^2
+	double radiusDif = std::fabs((double)params.outerRadius - params.innerRadius);
+	return radiusDif + radiusDif / std::fabs((double)params.innerRadius);
+}
+
+void CurveGenerator::hypocycloid(const CurveParams& params, double samplesPerRadian, const glm::dmat3& transform, size_t first, size_t count, glm::vec3* out) {
+	for (size_t i = 0; i < count; i++) {
+		glm::dvec2 p = hypocycloidPointPrecise(params, (double)(first + i) / samplesPerRadian);
+		glm::dvec3 mapped = transform * glm::dvec3(p, 1.0);
+		out[i] = glm::vec3((float)mapped.x, (float)mapped.y, 0.f);
+	}
+}
+
+// Largest factor a transform can stretch a distance by, the spectral norm of its 2x2 part
+static double stretch(const glm::dmat3& transform) {
+	double a = transform[0][0], b = transform[1][0], c = transform[0][1], d = transform[1][1];
+	double s = a * a + b * b + c * c + d * d;
+	double det = a * d - b * c;
+	return std::sqrt(0.5 * (s + std::sqrt(glm::max(s * s - 4 * det * det, 0.0))));
+}
+
+static void visibleRanges(const CurveParams& params, double samplesPerRadian, const glm::dmat3& transform, double reachPerSample,
+	glm::dvec2 viewMin, glm::dvec2 viewMax, size_t first, size_t last, size_t grain, std::vector<size_t>& firsts, std::vector<size_t>& counts) {
+	size_t middle = first + (last - first) / 2;
+	glm::dvec3 p = transform * glm::dvec3(CurveGenerator::hypocycloidPointPrecise(params, (double)middle / samplesPerRadian), 1.0);
+	glm::dvec2 outside = glm::max(glm::max(viewMin - glm::dvec2(p), glm::dvec2(p) - viewMax), glm::dvec2(0.0));
+	double reach = reachPerSample * (double)glm::max(middle - first, last - middle);
+	if (glm::length(outside) > reach) {
+		return;
+	}
+
+	if (last - first > grain) {
+		// the halves share the middle sample, so their strips join up again when both are kept
+		visibleRanges(params, samplesPerRadian, transform, reachPerSample, viewMin, viewMax, first, middle, grain, firsts, counts);
+		visibleRanges(params, samplesPerRadian, transform, reachPerSample, viewMin, viewMax, middle, last, grain, firsts, counts);
+		return;
+	}
+
+	if (!counts.empty() && firsts.back() + counts.back() - 1 == first) {
+		counts.back() += last - first;
+	}
+	else {
+		firsts.push_back(first);
+		counts.push_back(last - first + 1);
+	}
+}
+
+void CurveGenerator::hypocycloidVisible(const CurveParams& params, double samplesPerRadian, const glm::dmat3& transform,
+	glm::dvec2 viewMin, glm::dvec2 viewMax, size_t first, size_t last, size_t grain, std::vector<size_t>& firsts, std::vector<size_t>& counts) {
+	if (last <= first) {
+		return;
+	}
+	double reachPerSample = hypocycloidSpeed(params) * stretch(transform) / samplesPerRadian;
+	visibleRanges(params, samplesPerRadian, transform, reachPerSample, viewMin, viewMax, first, last, glm::max(grain, (size_t)1), firsts, counts);
+}
+
+size_t CurveGenerator::circleSampleCount(int detail) {
+	return (size_t)std::ceil(PI * 2 * detail + 1);
+}
+
+void CurveGenerator::circle(glm::vec3 center, float radius, int detail, size_t first, size_t count, glm::vec3* out) {
+	for (size_t i = 0; i < count; i++) {
+		float t = (float)(first + i) / (float)detail;
+		out[i] = center + glm::vec3(radius * cos(t), radius * sin(t), 0.f);
+	}
+}
+
+size_t CurveGenerator::quadraticSampleCount(float uStep) {
+	return (size_t)std::floor(1.0 / uStep + 0.5) + 1;
+}
+
+void CurveGenerator::quadratic(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float uStep, size_t first, size_t count, glm::vec3* out) {
+	for (size_t i = 0; i < count; i++) {
+		float u = (float)(first + i) * uStep;
+		out[i] = a + b * u + c * (u * u);
+	}
+}
+
+void CurveGenerator::hypocycloid(ThreadPool& pool, const CurveParams& params, size_t count, glm::vec3* out) {
+	pool.parallelFor(count, CHUNK_SIZE, [&](size_t begin, size_t end) {
+		hypocycloid(params, begin, end - begin, out + begin);
+	});
+}
+
+void CurveGenerator::circle(ThreadPool& pool, glm::vec3 center, float radius, int detail, glm::vec3* out) {
+	pool.parallelFor(circleSampleCount(detail), CHUNK_SIZE, [&](size_t begin, size_t end) {
+		circle(center, radius, detail, begin, end - begin, out + begin);
+	});
+}
+
+void CurveGenerator::quadratic(ThreadPool& pool, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float uStep, glm::vec3* out) {
+	pool.parallelFor(quadraticSampleCount(uStep), CHUNK_SIZE, [&](size_t begin, size_t end) {
+		quadratic(a, b, c, uStep, begin, end - begin, out + begin);
+	});
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// Parameters that determine the shape of a hypocycloid
+struct CurveParams {
+	float outerRadius;
+	float innerRadius;
+	int step;
+};
+
+// Evaluates the curves drawn by the program, free of any GL or window state so it can run on any thread.
+// Every curve is parameterized by sample index (theta_i = i / step) rather than a running accumulator,
+// so any slice of samples can be filled independently of the others.
+class CurveGenerator {
+
+public:
+	// Samples per chunk handed to the thread pool
+	static const size_t CHUNK_SIZE = 65536;
+
+	static glm::vec3 hypocycloidPoint(const CurveParams& params, float theta);
+	static float hypocycloidTheta(const CurveParams& params, size_t index);
+	// samples needed to go around the outer circle cycles times, endpoint included
+	static size_t hypocycloidSampleCount(const CurveParams& params, int cycles);
+	// fills out[0, count) with samples first .. first + count - 1
+	static void hypocycloid(const CurveParams& params, size_t first, size_t count, glm::vec3* out);
+
+	// Shifting theta by this angle turns the whole curve by the same angle, so the curve is a chain of congruent
+	// arcs, each a rotated copy of [0, arc]. 0 if the curve never repeats that way.
+	static double hypocycloidArcAngle(const CurveParams& params);
+	// If the arcs come back to the start, i.e. the curve closes after cycles turns of the outer circle, it has
+	// order-fold rotational symmetry. Returns false if it doesn't close within maxCycles turns.
+	static bool hypocycloidSymmetry(const CurveParams& params, int maxCycles, int& order, int& cycles);
+
+	// Double precision variants for deep zoom. samplesPerRadian replaces params.step so a curve can be sampled far
+	// more finely than an int allows, and transform (a 2D affine map, e.g. the model matrix followed by a shift to
+	// a nearby origin) is applied before rounding to float, so the float coordinates stay small.
+	static glm::dvec2 hypocycloidPointPrecise(const CurveParams& params, double theta);
+	// upper bound on how far the curve moves per radian
+	static double hypocycloidSpeed(const CurveParams& params);
+	static void hypocycloid(const CurveParams& params, double samplesPerRadian, const glm::dmat3& transform, size_t first, size_t count, glm::vec3* out);
+	// Appends the sample ranges within [first, last] whose stretch of curve may pass through [viewMin, viewMax] once
+	// transformed, each at most grain samples long and merged where they meet. Conservative: a range is only dropped
+	// if the curve can't reach the view from its middle sample at hypocycloidSpeed.
+	static void hypocycloidVisible(const CurveParams& params, double samplesPerRadian, const glm::dmat3& transform,
+		glm::dvec2 viewMin, glm::dvec2 viewMax, size_t first, size_t last, size_t grain, std::vector<size_t>& firsts, std::vector<size_t>& counts);
+
+	static size_t circleSampleCount(int detail);
+	static void circle(glm::vec3 center, float radius, int detail, size_t first, size_t count, glm::vec3* out);
+
+	// samples of the quadratic a + b*u + c*u^2 for u in [0, 1]
+	static size_t quadraticSampleCount(float uStep);
+	static void quadratic(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float uStep, size_t first, size_t count, glm::vec3* out);
+
+	// The same curves split across the pool, writing into out[0, count)
+	static void hypocycloid(ThreadPool& pool, const CurveParams& params, size_t count, glm::vec3* out);
+	static void circle(ThreadPool& pool, glm::vec3 center, float radius, int detail, glm::vec3* out);
+	static void quadratic(ThreadPool& pool, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float uStep, glm::vec3* out);
+};
@@ -0,0 +1,192 @@
+#include "CurveWorker.h"
+
+#include "Profiler.h"
+
+CurveWorker::CurveWorker(ThreadPool& pool, SceneArena& arena, const CurveCache& cache)
+	: pool(pool), arena(arena), cache(cache), latest(0), ready(nullptr), spare(nullptr) {
+	thread = std::thread(&CurveWorker::run, this);
+}
+
+CurveWorker::~CurveWorker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		latest++;
+	}
+	wake.notify_one();
+	thread.join();
+
+	delete ready.exchange(nullptr);
+	delete spare.exchange(nullptr);
+}
+
+unsigned int CurveWorker::request(const CurveParams& params, size_t sampleCount, double samplesPerRadian) {
+	unsigned int generation;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingParams = params;
+		pendingCount = sampleCount;
+		pendingSamplesPerRadian = samplesPerRadian;
+		pendingCached.reset();
+		hasRequest = true;
+		hasStore = false;
+		generation = ++latest;
+	}
+	wake.notify_one();
+	return generation;
+}
+
+unsigned int CurveWorker::request(const std::shared_ptr<const MappedCurve>& cached, size_t sampleCount) {
+	unsigned int generation;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingCount = sampleCount;
+		pendingCached = cached;
+		hasRequest = true;
+		hasStore = false;
+		generation = ++latest;
+	}
+	wake.notify_one();
+	return generation;
+}
+
+void CurveWorker::store(const CurveParams& params, size_t sampleCount) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		storeParams = params;
+		storeCount = sampleCount;
+		hasStore = true;
+	}
+	wake.notify_one();
+}
+
+void CurveWorker::cancel() {
+	std::lock_guard<std::mutex> lock(mutex);
+	hasRequest = false;
+	hasStore = false;
+	pendingCached.reset();
+	latest++;
+}
+
+CurveResult* CurveWorker::takeResult() {
+	return ready.exchange(nullptr);
+}
+
+CurveResult* CurveWorker::waitForResult(unsigned int generation) {
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&] { return ready.load() != nullptr || latest != generation; });
+	return takeResult();
+}
+
+// Keeps one spare buffer around so steady regeneration doesn't reallocate
+void CurveWorker::recycle(CurveResult* result) {
+	if (result == nullptr) {
+		return;
+	}
+	// the mapping isn't needed any more, and Windows won't replace a file that is still mapped
+	result->cached.reset();
+	delete spare.exchange(result);
+}
+
+void CurveWorker::run() {
+	PROFILE_THREAD("curve worker");
+	while (true) {
+		CurveParams params;
+		size_t count;
+		double samplesPerRadian;
+		std::shared_ptr<const MappedCurve> cached;
+		unsigned int generation;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || hasRequest || hasStore; });
+			if (stopping) {
+				return;
+			}
+			// curves come first, a store only runs while there is nothing else to do
+			if (!hasRequest) {
+				params = storeParams;
+				count = storeCount;
+				generation = latest;
+				hasStore = false;
+				lock.unlock();
+				storeCurve(params, count, generation);
+				continue;
+			}
+			params = pendingParams;
+			count = pendingCount;
+			samplesPerRadian = pendingSamplesPerRadian;
+			cached.swap(pendingCached);
+			generation = latest;
+			hasRequest = false;
+		}
+
+		CurveResult* result = spare.exchange(nullptr);
+		if (result == nullptr) {
+			result = new CurveResult(arena);
+		}
+		if (cached) {
+			PROFILE_ZONE("indexCachedCurve");
+			result->verts.clear();
+			result->bvh.build(pool, cached->vertices(), count);
+			if (latest != generation) {
+				recycle(result);
+				continue;
+			}
+			result->cached.swap(cached);
+			publish(result, generation);
+			continue;
+		}
+
+		PROFILE_ZONE("generateCurve");
+		result->verts.resize(count);
+
+		// chunks check for a newer request before starting, so a stale curve stops within one chunk per core
+		glm::vec3* out = result->verts.data();
+		pool.parallelFor(count, CurveGenerator::CHUNK_SIZE, [&](size_t begin, size_t end) {
+			if (latest != generation) {
+				return;
+			}
+			// the float kernel only does whole samples per radian
+			if (samplesPerRadian == params.step) {
+				CurveGenerator::hypocycloid(params, begin, end - begin, out + begin);
+			}
+			else {
+				CurveGenerator::hypocycloid(params, samplesPerRadian, glm::dmat3(1.0), begin, end - begin, out + begin);
+			}
+		});
+
+		if (latest != generation) {
+			recycle(result);
+			continue;
+		}
+		result->bvh.build(pool, out, count);
+		publish(result, generation);
+	}
+}
+
+void CurveWorker::storeCurve(const CurveParams& params, size_t count, unsigned int generation) {
+	PROFILE_ZONE("storeCurve");
+	cache.store(params, count, [&](size_t first, size_t blockCount, glm::vec3* out) {
+		if (latest != generation) {
+			return false;
+		}
+		pool.parallelFor(blockCount, CurveGenerator::CHUNK_SIZE, [&](size_t begin, size_t end) {
+			CurveGenerator::hypocycloid(params, first + begin, end - begin, out + begin);
+		});
+		return true;
+	});
+}
+
+void CurveWorker::publish(CurveResult* result, unsigned int generation) {
+	result->generation = generation;
+	// an older result nobody picked up yet is stale now
+	recycle(ready.exchange(result));
+	{
+		// taking the lock orders this with a waiter checking its condition
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+	finished.notify_all();
+	if (onFinished) {
+		onFinished();
+	}
+}
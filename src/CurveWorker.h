@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "CurveCache.h"
+#include "CurveGenerator.h"
+#include "SceneArena.h"
+#include "SegmentBVH.h"
+#include "ThreadPool.h"
+#include "VertexArray.h"
+
+// A finished curve handed from the worker to the render thread
+struct CurveResult {
+	CurveResult(SceneArena& arena) : verts(arena), generation(0) {}
+
+	VertexArray verts;
+	// built over verts on the worker too, so culling and picking are ready when the curve arrives
+	SegmentBVH bvh;
+	unsigned int generation;
+	// for a cached curve only the BVH is built, over its mapping, and verts stays empty
+	std::shared_ptr<const MappedCurve> cached;
+};
+
+// Generates curves on a background thread so the render thread can keep drawing the last finished one.
+// Results are double buffered: the worker fills a back buffer and publishes it with an atomic swap.
+class CurveWorker {
+
+public:
+	CurveWorker(ThreadPool& pool, SceneArena& arena, const CurveCache& cache);
+	~CurveWorker();
+
+	// Queues the first sampleCount samples of a curve, sample i at theta = i / samplesPerRadian, and returns its
+	// generation. Anything older that is still being generated gets cancelled.
+	unsigned int request(const CurveParams& params, size_t sampleCount, double samplesPerRadian);
+	// Queues building the BVH over the first sampleCount vertices of a cached curve, which the request keeps mapped
+	unsigned int request(const std::shared_ptr<const MappedCurve>& cached, size_t sampleCount);
+	// Queues writing the first sampleCount samples of a curve, at params.step samples per radian, to the cache.
+	// They are generated again a block at a time rather than read from the render thread's copy. A request or
+	// cancel() before it is done abandons it, so it never holds up a new curve.
+	void store(const CurveParams& params, size_t sampleCount);
+	// Cancels any outstanding request or store without queueing a new one
+	void cancel();
+
+	// Takes the most recently completed curve, or nullptr if there isn't one. Hand it back with recycle().
+	CurveResult* takeResult();
+	// Blocks until the given request has finished or was superseded, then takes the result like takeResult()
+	CurveResult* waitForResult(unsigned int generation);
+	void recycle(CurveResult* result);
+
+	// Called on the worker thread whenever a result is published, e.g. to wake a sleeping event loop.
+	// Set it before the first request.
+	void setFinishedCallback(const std::function<void()>& callback) { onFinished = callback; }
+
+private:
+	void run();
+	void publish(CurveResult* result, unsigned int generation);
+	void storeCurve(const CurveParams& params, size_t count, unsigned int generation);
+
+	ThreadPool& pool;
+	SceneArena& arena;
+	const CurveCache& cache;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	// guarded by mutex
+	bool stopping = false;
+	bool hasRequest = false;
+	CurveParams pendingParams;
+	size_t pendingCount = 0;
+	double pendingSamplesPerRadian = 0.0;
+	std::shared_ptr<const MappedCurve> pendingCached;
+	bool hasStore = false;
+	CurveParams storeParams;
+	size_t storeCount = 0;
+
+	std::atomic<unsigned int> latest;
+	std::atomic<CurveResult*> ready;
+	std::atomic<CurveResult*> spare;
+
+	std::function<void()> onFinished;
+};
@@ -0,0 +1,98 @@
+#include "DensityMap.h"
+
+#include <cmath>
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+// Samples generated at a time by each thread, small enough to stay in cache before they are binned
+static const size_t DENSITY_BLOCK = 1024;
+// Rows tone mapped per task
+static const size_t ROW_GRAIN = 64;
+
+void DensityMap::resize(int width, int height) {
+	width = glm::max(width, 0);
+	height = glm::max(height, 0);
+	if (width != imageWidth || height != imageHeight) {
+		imageWidth = width;
+		imageHeight = height;
+		counts.reset(new std::atomic<uint32_t>[(size_t)width * height]);
+	}
+	clear();
+}
+
+void DensityMap::clear() {
+	size_t pixels = (size_t)imageWidth * imageHeight;
+	for (size_t i = 0; i < pixels; i++) {
+		counts[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void DensityMap::accumulate(const CurveParams& params, const glm::dmat3& toPixels, size_t first, size_t count) {
+	glm::vec3 samples[DENSITY_BLOCK];
+	for (size_t done = 0; done < count; done += DENSITY_BLOCK) {
+		size_t n = glm::min(DENSITY_BLOCK, count - done);
+		CurveGenerator::hypocycloid(params, first + done, n, samples);
+		for (size_t i = 0; i < n; i++) {
+			// in double, the translation can be large when the view is zoomed in far from the origin
+			glm::dvec3 p = toPixels * glm::dvec3(samples[i].x, samples[i].y, 1.0);
+			// written so a NaN from a degenerate curve is dropped too
+			if (!(p.x >= 0 && p.y >= 0 && p.x < imageWidth && p.y < imageHeight)) {
+				continue;
+			}
+			size_t pixel = (size_t)p.y * imageWidth + (size_t)p.x;
+			counts[pixel].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+void DensityMap::accumulate(ThreadPool& pool, const CurveParams& params, const glm::dmat3& toPixels, size_t first, size_t count) {
+	PROFILE_ZONE("accumulateDensity");
+	pool.parallelFor(count, CurveGenerator::CHUNK_SIZE, [&](size_t begin, size_t end) {
+		accumulate(params, toPixels, first + begin, end - begin);
+	});
+}
+
+void DensityMap::statistics(uint32_t& peak, double& mean) const {
+	peak = 0;
+	double sum = 0;
+	size_t touched = 0;
+	size_t pixels = (size_t)imageWidth * imageHeight;
+	for (size_t i = 0; i < pixels; i++) {
+		uint32_t c = counts[i].load(std::memory_order_relaxed);
+		if (c > 0) {
+			peak = glm::max(peak, c);
+			sum += c;
+			touched++;
+		}
+	}
+	mean = touched > 0 ? sum / touched : 1.0;
+}
+
+void DensityMap::toneMapRows(int firstRow, int lastRow, double scale, double normalize, uint8_t* out) const {
+	for (size_t i = (size_t)firstRow * imageWidth; i < (size_t)lastRow * imageWidth; i++) {
+		uint32_t c = counts[i].load(std::memory_order_relaxed);
+		out[i] = c == 0 ? 0 : (uint8_t)glm::min(255.0, 255.0 * std::log1p(scale * c) * normalize + 0.5);
+	}
+}
+
+void DensityMap::toneMap(ThreadPool& pool, float exposure, uint8_t* out) const {
+	PROFILE_ZONE("toneMapDensity");
+	uint32_t peak;
+	double mean;
+	statistics(peak, mean);
+	double scale = exposure / mean;
+	double normalize = peak > 0 ? 1.0 / std::log1p(scale * peak) : 0.0;
+	pool.parallelFor(imageHeight, ROW_GRAIN, [&](size_t begin, size_t end) {
+		toneMapRows((int)begin, (int)end, scale, normalize, out);
+	});
+}
+
+void DensityMap::toneMap(float exposure, uint8_t* out) const {
+	uint32_t peak;
+	double mean;
+	statistics(peak, mean);
+	double scale = exposure / mean;
+	double normalize = peak > 0 ? 1.0 / std::log1p(scale * peak) : 0.0;
+	toneMapRows(0, imageHeight, scale, normalize, out);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "CurveGenerator.h"
+
+class ThreadPool;
+
+// Counts how often a curve passes through each pixel of an image, for curves far too long to draw as lines.
+// Samples are streamed from CurveGenerator in small blocks and binned straight away, so memory stays at one
+// image of counts however many samples go in.
+class DensityMap {
+
+public:
+	// tone mapping contrast the UI and the batch renderer start with
+	static constexpr float DEFAULT_EXPOSURE = 4.f;
+
+	// Also clears the counts
+	void resize(int width, int height);
+	void clear();
+
+	int width() const { return imageWidth; }
+	int height() const { return imageHeight; }
+
+	// Bins hypocycloid samples first .. first + count - 1. toPixels maps the curve's own coordinates to pixels,
+	// x to the right and y down like Rasterizer; samples landing outside the image are dropped.
+	void accumulate(const CurveParams& params, const glm::dmat3& toPixels, size_t first, size_t count);
+	// The same split across the pool, the counts are atomic so every thread bins into the one image
+	void accumulate(ThreadPool& pool, const CurveParams& params, const glm::dmat3& toPixels, size_t first, size_t count);
+
+	// 8-bit gray, log(1 + exposure * count / mean) scaled so the busiest pixel is white, where mean is taken over
+	// the pixels the curve touched. Dividing by the mean keeps the picture steady as samples keep coming in.
+	void toneMap(ThreadPool& pool, float exposure, uint8_t* out) const;
+	void toneMap(float exposure, uint8_t* out) const;
+
+private:
+	void toneMapRows(int firstRow, int lastRow, double scale, double normalize, uint8_t* out) const;
+	// busiest pixel and mean over touched pixels
+	void statistics(uint32_t& peak, double& mean) const;
+
+	int imageWidth = 0;
+	int imageHeight = 0;
+	// 32 bits per pixel: a single pixel would need billions of samples to itself to overflow
+	std::unique_ptr<std::atomic<uint32_t>[]> counts;
+};
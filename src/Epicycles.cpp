@@ -0,0 +1,179 @@
+#include "Epicycles.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+static const double PI = 3.14159265358979323846264338327950288;
+// Samples the batch kernel evaluates side by side. Each term turns every lane on by the same rotor, so the
+// lanes never depend on each other and the inner loop compiles to vector instructions; with 8 lanes GCC's -O3
+// unrolls the loop completely and then fails to vectorize what is left.
+static const size_t EVAL_LANES = 16; // a power of two
+// rows of lanes per block; a row is the one above turned by one more rotor step, which keeps the trig down to
+// a couple of calls per term and block while the float error from chaining rotors stays far below a pixel
+static const size_t EVAL_ROWS = 16;
+static const size_t EVAL_BLOCK = EVAL_LANES * EVAL_ROWS;
+
+void Epicycles::clear() {
+	frequencies.clear();
+	re.clear();
+	im.clear();
+}
+
+void Epicycles::fit(const glm::vec2* points, size_t count, size_t sampleCount) {
+	PROFILE_ZONE("fitEpicycles");
+	clear();
+	if (count == 0 || sampleCount == 0) {
+		return;
+	}
+
+	// length along the path up to each point, with the segment that closes it at the end
+	std::vector<double> lengths(count + 1);
+	lengths[0] = 0.0;
+	for (size_t i = 1; i <= count; i++) {
+		lengths[i] = lengths[i - 1] + glm::distance(glm::dvec2(points[i - 1]), glm::dvec2(points[i % count]));
+	}
+
+	// evenly spaced by length, so the speed along the path doesn't depend on how fast it was drawn
+	std::vector<std::complex<double>> samples(sampleCount);
+	size_t segment = 0;
+	for (size_t n = 0; n < sampleCount; n++) {
+		double s = lengths[count] * (double)n / (double)sampleCount;
+		while (segment + 1 < count && lengths[segment + 1] <= s) {
+			segment++;
+		}
+		double length = lengths[segment + 1] - lengths[segment];
+		double u = length > 0.0 ? (s - lengths[segment]) / length : 0.0;
+		glm::dvec2 p = glm::mix(glm::dvec2(points[segment]), glm::dvec2(points[(segment + 1) % count]), u);
+		samples[n] = std::complex<double>(p.x, p.y);
+	}
+
+	fft(samples, false);
+
+	std::vector<size_t> order(sampleCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return std::norm(samples[a]) > std::norm(samples[b]);
+	});
+
+	frequencies.resize(sampleCount);
+	re.resize(sampleCount);
+	im.resize(sampleCount);
+	for (size_t j = 0; j < sampleCount; j++) {
+		size_t k = order[j];
+		// bins past the middle are the negative frequencies, the circles turning the other way
+		frequencies[j] = k < sampleCount / 2 ? (int)k : (int)k - (int)sampleCount;
+		re[j] = (float)(samples[k].real() / (double)sampleCount);
+		im[j] = (float)(samples[k].imag() / (double)sampleCount);
+	}
+}
+
+void Epicycles::evaluate(size_t terms, double t0, double dt, size_t count, glm::vec3* out) const {
+	terms = glm::min(terms, size());
+	float x[EVAL_BLOCK];
+	float y[EVAL_BLOCK];
+	float cr[EVAL_LANES];
+	float ci[EVAL_LANES];
+	for (size_t done = 0; done < count; done += EVAL_BLOCK) {
+		size_t n = glm::min(EVAL_BLOCK, count - done);
+		double start = t0 + dt * (double)done;
+		std::fill(x, x + EVAL_BLOCK, 0.f);
+		std::fill(y, y + EVAL_BLOCK, 0.f);
+
+		for (size_t j = 0; j < terms; j++) {
+			double f = frequencies[j];
+			// the first row's rotors e^(i f t), built in double from two exact ones so each term costs two
+			// sin/cos pairs per block instead of one per lane. Multiplied out by hand, std::complex products
+			// go through a library call that checks for infinities.
+			double laneR = std::cos(f * start);
+			double laneI = std::sin(f * start);
+			double stepR = std::cos(f * dt);
+			double stepI = std::sin(f * dt);
+			for (size_t l = 0; l < EVAL_LANES; l++) {
+				cr[l] = (float)laneR;
+				ci[l] = (float)laneI;
+				double r = laneR * stepR - laneI * stepI;
+				laneI = laneR * stepI + laneI * stepR;
+				laneR = r;
+			}
+			// a row is EVAL_LANES lane steps further on
+			for (size_t l = 1; l < EVAL_LANES; l <<= 1) {
+				double r = stepR * stepR - stepI * stepI;
+				stepI = 2 * stepR * stepI;
+				stepR = r;
+			}
+			float sr = (float)stepR;
+			float si = (float)stepI;
+			float a = re[j];
+			float b = im[j];
+			for (size_t row = 0; row < EVAL_ROWS; row++) {
+				float* rowX = x + row * EVAL_LANES;
+				float* rowY = y + row * EVAL_LANES;
+				for (size_t l = 0; l < EVAL_LANES; l++) {
+					rowX[l] += a * cr[l] - b * ci[l];
+					rowY[l] += a * ci[l] + b * cr[l];
+					float r = cr[l] * sr - ci[l] * si;
+					ci[l] = cr[l] * si + ci[l] * sr;
+					cr[l] = r;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			out[done + i] = glm::vec3(x[i], y[i], 0.f);
+		}
+	}
+}
+
+void Epicycles::evaluate(ThreadPool& pool, size_t terms, size_t count, glm::vec3* out) const {
+	PROFILE_ZONE("evaluateEpicycles");
+	double dt = count > 1 ? 2 * PI / (double)(count - 1) : 0.0;
+	pool.parallelFor(count, EVAL_BLOCK, [&](size_t begin, size_t end) {
+		evaluate(terms, dt * (double)begin, dt, end - begin, out + begin);
+	});
+}
+
+void Epicycles::chain(size_t terms, double t, glm::vec3* out) const {
+	terms = glm::min(terms, size());
+	glm::vec2 tip(0.f);
+	out[0] = glm::vec3(tip, 0.f);
+	for (size_t j = 0; j < terms; j++) {
+		double angle = frequencies[j] * t;
+		float c = (float)std::cos(angle);
+		float s = (float)std::sin(angle);
+		tip += glm::vec2(re[j] * c - im[j] * s, re[j] * s + im[j] * c);
+		out[j + 1] = glm::vec3(tip, 0.f);
+	}
+}
+
+void Epicycles::fft(std::vector<std::complex<double>>& data, bool inverse) {
+	size_t n = data.size();
+	// bit-reversed order, so the butterflies below can work in place
+	for (size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			std::swap(data[i], data[j]);
+		}
+	}
+
+	double sign = inverse ? 1.0 : -1.0;
+	for (size_t length = 2; length <= n; length <<= 1) {
+		size_t half = length / 2;
+		for (size_t k = 0; k < half; k++) {
+			// each twiddle from its own angle, products of a rotor drift over long transforms
+			std::complex<double> w = std::polar(1.0, sign * 2 * PI * (double)k / (double)length);
+			for (size_t start = 0; start < n; start += length) {
+				std::complex<double> u = data[start + k];
+				std::complex<double> v = data[start + k + half] * w;
+				data[start + k] = u + v;
+				data[start + k + half] = u - v;
+			}
+		}
+	}
+}
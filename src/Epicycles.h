@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// A closed path as a chain of rotating circles, the general case of the hypocycloid's two: term j turns at
+// integer frequency f_j with complex radius c_j, and the chain's tip at time t in [0, 2 pi) is sum c_j e^(i f_j t).
+// The terms are fitted to a path with an FFT and kept sorted by radius, largest first, so the first k of them are
+// the best k-term approximation and truncating is just summing fewer.
+class Epicycles {
+
+public:
+	// samples the UI fits strokes with, i.e. how many terms there are to choose from
+	static const size_t DEFAULT_FIT_SAMPLES = 4096;
+
+	// Fits the terms to the closed path through points[0, count), the last point joining back to the first.
+	// The path is resampled to sampleCount points evenly spaced along its length, which must be a power of two,
+	// and every one of the sampleCount frequencies the FFT gives is kept.
+	void fit(const glm::vec2* points, size_t count, size_t sampleCount);
+	void clear();
+
+	size_t size() const { return frequencies.size(); }
+	bool empty() const { return frequencies.empty(); }
+	int frequency(size_t term) const { return frequencies[term]; }
+	float radius(size_t term) const { return std::hypot(re[term], im[term]); }
+
+	// The first `terms` terms summed at times t0, t0 + dt, ..., for count samples
+	void evaluate(size_t terms, double t0, double dt, size_t count, glm::vec3* out) const;
+	// count samples over one turn, t = 2 pi i / (count - 1) so the last one closes the path, split across the pool
+	void evaluate(ThreadPool& pool, size_t terms, size_t count, glm::vec3* out) const;
+	// The chain at time t: out[0] is the origin and out[j] the tip after the first j terms, terms + 1 points
+	void chain(size_t terms, double t, glm::vec3* out) const;
+
+	// In place discrete Fourier transform of a power-of-two number of values, sum x_n e^(-2 pi i k n / N),
+	// or with inverse the same with e^(+...) and no 1 / N
+	static void fft(std::vector<std::complex<double>>& data, bool inverse);
+
+private:
+	// terms as a structure of arrays, in order of decreasing radius
+	std::vector<int> frequencies;
+	std::vector<float> re;
+	std::vector<float> im;
+};
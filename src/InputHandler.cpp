@@ -1,9 +1,18 @@
 #include "InputHandler.h"
 
+#include "imgui.h"
+
 RenderEngine* InputHandler::renderEngine;
 int InputHandler::mouseOldX;
 int InputHandler::mouseOldY;
 glm::vec3* InputHandler::mousePos;
+bool InputHandler::activity;
+bool InputHandler::panning;
+bool InputHandler::capturingStrokes;
+bool InputHandler::stroking;
+bool InputHandler::strokeEnded;
+std::vector<glm::vec2> InputHandler::strokePoints;
+std::vector<InputHandler::CameraMove> InputHandler::cameraMoves;
 
 // Must be called before processing any GLFW events
 void InputHandler::setUp(RenderEngine* renderEngine, glm::vec3* pos) {
@@ -13,6 +22,7 @@ void InputHandler::setUp(RenderEngine* renderEngine, glm::vec3* pos) {
 
 // Callback for key presses
 void InputHandler::key(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	activity = true;
 	if (key == GLFW_KEY_ESCAPE) {
 		glfwDestroyWindow(window);
 		glfwTerminate();
@@ -22,6 +32,21 @@ void InputHandler::key(GLFWwindow* window, int key, int scancode, int action, in
 
 // Callback for mouse button presses
 void InputHandler::mouse(GLFWwindow* window, int button, int action, int mods) {
+	activity = true;
+	if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+		panning = action == GLFW_PRESS && !ImGui::GetIO().WantCaptureMouse;
+		return;
+	}
+	if (button == GLFW_MOUSE_BUTTON_LEFT && capturingStrokes) {
+		if (action == GLFW_PRESS && !ImGui::GetIO().WantCaptureMouse) {
+			stroking = true;
+			strokePoints.push_back(glm::vec2(mouseOldX, mouseOldY));
+		}
+		else if (action == GLFW_RELEASE && stroking) {
+			stroking = false;
+			strokeEnded = true;
+		}
+	}
 	if(action==GLFW_PRESS)	{
 		// std::cout << mouseOldX << ", " << mouseOldY << std::endl;
 		mousePos->x = mouseOldX;
@@ -32,15 +57,63 @@ void InputHandler::mouse(GLFWwindow* window, int button, int action, int mods) {
 
 // Callback for mouse motion
 void InputHandler::motion(GLFWwindow* window, double x, double y) {
+	activity = true;
+	if (panning) {
+		cameraMoves.push_back({ (float)(x - mouseOldX), (float)(y - mouseOldY), 0.f });
+	}
+	if (stroking) {
+		strokePoints.push_back(glm::vec2(x, y));
+	}
 	mouseOldX = x;
 	mouseOldY = y;
 }
 
 // Callback for mouse scroll
 void InputHandler::scroll(GLFWwindow* window, double x, double y) {
+	activity = true;
+	if (ImGui::GetIO().WantCaptureMouse) {
+		return;
+	}
+	// zoom around the cursor, each notch by 20%
+	double cursorX, cursorY;
+	glfwGetCursorPos(window, &cursorX, &cursorY);
+	cameraMoves.push_back({ (float)cursorX, (float)cursorY, (float)pow(1.2, y) });
 }
 
 // Callback for window reshape/resize
 void InputHandler::reshape(GLFWwindow* window, int width, int height) {
+	activity = true;
 	renderEngine->setWindowSize(width, height);
 }
+
+// Callback for the window contents needing a redraw, e.g. after being uncovered
+void InputHandler::refresh(GLFWwindow* window) {
+	activity = true;
+}
+
+bool InputHandler::takeActivity() {
+	bool active = activity;
+	activity = false;
+	return active;
+}
+
+void InputHandler::captureStrokes(bool capture) {
+	capturingStrokes = capture;
+	if (!capture && stroking) {
+		stroking = false;
+		strokeEnded = true;
+	}
+}
+
+bool InputHandler::takeStroke(std::vector<glm::vec2>& points) {
+	points.insert(points.end(), strokePoints.begin(), strokePoints.end());
+	strokePoints.clear();
+	bool ended = strokeEnded;
+	strokeEnded = false;
+	return ended;
+}
+
+void InputHandler::takeCameraMoves(std::vector<CameraMove>& moves) {
+	moves.insert(moves.end(), cameraMoves.begin(), cameraMoves.end());
+	cameraMoves.clear();
+}
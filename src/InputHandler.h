@@ -4,12 +4,21 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <vector>
 
 #include "RenderEngine.h"
 
 class InputHandler {
 
 public:
+	// A drag with the right button by (x, y) pixels when factor is 0, otherwise a scroll zooming by factor about
+	// the cursor at (x, y)
+	struct CameraMove {
+		float x;
+		float y;
+		float factor;
+	};
+
 	static void setUp(RenderEngine* renderEngine, glm::vec3* pos);
 
 	static void key(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -17,6 +26,18 @@ public:
 	static void motion(GLFWwindow* window, double x, double y);
 	static void scroll(GLFWwindow* window, double x, double y);
 	static void reshape(GLFWwindow* window, int width, int height);
+	static void refresh(GLFWwindow* window);
+
+	// Whether any input arrived since the last call, used to decide when the program can idle
+	static bool takeActivity();
+
+	// While capturing, dragging with the left button draws a freehand stroke
+	static void captureStrokes(bool capture);
+	// Moves the stroke positions collected since the last call onto the end of points, in window coordinates.
+	// Returns true when the stroke has ended since, i.e. the button was let go.
+	static bool takeStroke(std::vector<glm::vec2>& points);
+	// Moves the pans and zooms since the last call onto the end of moves, for the caller to apply
+	static void takeCameraMoves(std::vector<CameraMove>& moves);
 
 
 private:
@@ -25,4 +46,14 @@ private:
 
 	static int mouseOldX;
 	static int mouseOldY;
+
+	static bool activity;
+	// dragging with the right button pans the view
+	static bool panning;
+	static bool capturingStrokes;
+	// a stroke is being drawn, and one ended that takeStroke hasn't reported yet
+	static bool stroking;
+	static bool strokeEnded;
+	static std::vector<glm::vec2> strokePoints;
+	static std::vector<CameraMove> cameraMoves;
 };
@@ -0,0 +1,147 @@
+#include "Profiler.h"
+
+#ifdef HYPO_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_TSC 1
+#endif
+
+namespace {
+
+struct ZoneEvent {
+	const char* name;
+	uint64_t start;
+	uint64_t end;
+};
+
+const size_t RING_SIZE = 1 << 16;
+
+struct ThreadBuffer {
+	// total zones ever written, the ring holds the last RING_SIZE of them
+	std::atomic<uint64_t> written{ 0 };
+	ZoneEvent events[RING_SIZE];
+	unsigned int id;
+	const char* name = nullptr;
+};
+
+// Reference points for turning timestamps into microseconds: the TSC has no fixed unit,
+// so its rate is measured against steady_clock between the first zone and the dump
+struct Epoch {
+	uint64_t ticks;
+	std::chrono::steady_clock::time_point time;
+	Epoch() : ticks(Profiler::now()), time(std::chrono::steady_clock::now()) {}
+};
+
+Epoch& epoch() {
+	static Epoch start;
+	return start;
+}
+
+// Buffers outlive their threads so zones of finished threads still end up in the dump
+std::mutex buffersMutex;
+std::vector<ThreadBuffer*> buffers;
+
+ThreadBuffer* registerThread() {
+	epoch();
+	ThreadBuffer* buffer = new ThreadBuffer();
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	buffer->id = (unsigned int)buffers.size();
+	buffers.push_back(buffer);
+	return buffer;
+}
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer& currentBuffer() {
+	if (threadBuffer == nullptr) {
+		threadBuffer = registerThread();
+	}
+	return *threadBuffer;
+}
+
+}
+
+uint64_t Profiler::now() {
+#ifdef PROFILE_TSC
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+	ThreadBuffer& buffer = currentBuffer();
+	uint64_t index = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[index % RING_SIZE] = { name, start, end };
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName(const char* name) {
+	currentBuffer().name = name;
+}
+
+bool Profiler::dump(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (file == nullptr) {
+		return false;
+	}
+
+	Epoch& start = epoch();
+	double elapsedMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start.time).count();
+	uint64_t elapsedTicks = now() - start.ticks;
+	double microsPerTick = elapsedTicks > 0 ? elapsedMicros / elapsedTicks : 0;
+
+	std::vector<ZoneEvent> copy;
+	std::vector<ThreadBuffer*> threads;
+	{
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		threads = buffers;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first = true;
+	for (ThreadBuffer* buffer : threads) {
+		if (buffer->name != nullptr) {
+			fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", buffer->id, buffer->name);
+			first = false;
+		}
+
+		// the owner keeps writing while we copy, anything it may have lapped in the meantime is dropped afterwards
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t begin = written > RING_SIZE ? written - RING_SIZE : 0;
+		copy.clear();
+		for (uint64_t i = begin; i < written; i++) {
+			copy.push_back(buffer->events[i % RING_SIZE]);
+		}
+		// once written reads W, the owner may already be writing slot W % RING_SIZE, i.e. copy index W - RING_SIZE - begin
+		uint64_t overwritten = buffer->written.load(std::memory_order_acquire);
+		size_t skip = overwritten >= begin + RING_SIZE ? (size_t)std::min(overwritten - begin - RING_SIZE + 1, (uint64_t)copy.size()) : 0;
+
+		for (size_t i = skip; i < copy.size(); i++) {
+			const ZoneEvent& event = copy[i];
+			// zones from before the epoch was taken can't be placed on the timeline
+			if (event.start < start.ticks) {
+				continue;
+			}
+			double ts = (event.start - start.ticks) * microsPerTick;
+			double dur = (event.end - event.start) * microsPerTick;
+			fprintf(file, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n", event.name, buffer->id, ts, dur);
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+#endif
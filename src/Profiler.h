@@ -0,0 +1,55 @@
+#pragma once
+
+// Scoped profiling zones dumped as Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev).
+// Only compiled in when HYPO_PROFILE is defined, otherwise every macro expands to nothing.
+//
+//   void Program::updateCycloid() {
+//       PROFILE_ZONE("updateCycloid");
+//       ...
+//
+// Zone names must be string literals, only the pointer is stored.
+
+#ifdef HYPO_PROFILE
+
+#include <cstdint>
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#define PROFILE_DUMP(path) Profiler::dump(path)
+
+// Every thread records into its own ring buffer, so recording a zone takes no locks and no atomics
+// beyond publishing the write position. When a buffer wraps, the oldest zones are overwritten.
+class Profiler {
+
+public:
+	static uint64_t now();
+	static void record(const char* name, uint64_t start, uint64_t end);
+	// name shown for the calling thread in the trace
+	static void setThreadName(const char* name);
+	// Writes what every thread's buffer currently holds. Zones still being written are skipped.
+	static bool dump(const char* path);
+};
+
+class ProfileZone {
+
+public:
+	explicit ProfileZone(const char* name) : name(name), start(Profiler::now()) {}
+	~ProfileZone() { Profiler::record(name, start, Profiler::now()); }
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* name;
+	uint64_t start;
+};
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_DUMP(path) ((void)0)
+
+#endif
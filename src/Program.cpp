@@ -1,10 +1,26 @@
 #include "Program.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "Profiler.h"
+#include "UploadBenchmark.h"
+
 // float Program::offset[] = { 0,0 };
 
 Program::Program() {
 	window = nullptr;
 	renderEngine = nullptr;
+	sceneArena = nullptr;
+	scene = nullptr;
+	threadPool = nullptr;
+	curveWorker = nullptr;
+	curveCache = nullptr;
+	sessionRecorder = nullptr;
+	sessionPath = nullptr;
+	sessionReportPath = nullptr;
 }
 
 // Error callback for glfw errors
@@ -29,13 +45,72 @@ void Program::start() {
 	}
 	*/
 	renderEngine = new RenderEngine(window);
+	sceneArena = new SceneArena();
+	scene = new Scene(*sceneArena);
+	threadPool = new ThreadPool();
+	curveCache = new CurveCache("cache");
+	curveWorker = new CurveWorker(*threadPool, *sceneArena, *curveCache);
+	// a finished curve has to wake the loop when it is idling
+	curveWorker->setFinishedCallback([] { glfwPostEmptyEvent(); });
 
 	mousePosition = new glm::vec3(0);
 
+	if (sessionPath != nullptr) {
+		sessionRecorder = new SessionRecorder();
+		int width, height;
+		if (sessionReportPath == nullptr) {
+			glfwGetWindowSize(window, &width, &height);
+			if (!sessionRecorder->startRecording(sessionPath, width, height)) {
+				std::cerr << "Could not record to " << sessionPath << std::endl;
+			}
+		}
+		else if (sessionRecorder->startReplay(sessionPath, width, height)) {
+			glfwSetWindowSize(window, width, height);
+			// run as fast as the frames allow, timing is what the replay is for
+			glfwSwapInterval(0);
+		}
+		else {
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	InputHandler::setUp(renderEngine, mousePosition);
 	mainLoop();
 }
 
+void Program::record(const char* path) {
+	sessionPath = path;
+	start();
+}
+
+void Program::replay(const char* path, const char* reportPath) {
+	sessionPath = path;
+	sessionReportPath = reportPath;
+	start();
+}
+
+void Program::benchmarkUploads(const char* reportPath) {
+	setupWindow();
+	if (glewInit() != GLEW_OK) {
+		std::cerr << "Could not initialize GLEW" << std::endl;
+		return;
+	}
+	// frames should take as long as the work in them, not the display refresh
+	glfwSwapInterval(0);
+
+	renderEngine = new RenderEngine(window);
+	sceneArena = new SceneArena();
+	UploadBenchmark(window, *renderEngine, *sceneArena).run(reportPath);
+
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplGlfw_Shutdown();
+	ImGui::DestroyContext();
+	delete sceneArena;
+	delete renderEngine;
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
+
 // Creates GLFW window for the program and sets callbacks for input
 void Program::setupWindow() {
 	glfwSetErrorCallback(Program::error);
@@ -53,6 +128,7 @@ void Program::setupWindow() {
 	glfwSetCursorPosCallback(window, InputHandler::motion);
 	glfwSetScrollCallback(window, InputHandler::scroll);
 	glfwSetWindowSizeCallback(window, InputHandler::reshape);
+	glfwSetWindowRefreshCallback(window, InputHandler::refresh);
 
 	// Setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -74,18 +150,302 @@ void Program::setupWindow() {
 
 // Creates an object from specified vertices - no texture. Default object is a 2D triangle.
 void Program::createTestGeometryObject() {
-	Geometry* testObject = new Geometry();
+	GeometryHandle testObject = scene->create(GL_TRIANGLES);
+
+	scene->verts(testObject).push_back(glm::vec3(-5.f, -3.f, 0.f));
+	scene->verts(testObject).push_back(glm::vec3(5.f, -3.f, 0.f));
+	scene->verts(testObject).push_back(glm::vec3(0.f, 5.f, 0.f));
+	renderEngine->assignBuffers(*scene, testObject);
+	renderEngine->updateBuffers(*scene, testObject);
+}
+
+// Derived geometry invalidated by each parameter, indexed by ParamId
+const unsigned int Program::paramInvalidates[PARAM_COUNT] = {
+	DIRTY_CYCLOID | DIRTY_INNER_CIRCLE | DIRTY_LAST_POINT,						// PARAM_INNER_RADIUS
+	DIRTY_CYCLOID | DIRTY_INNER_CIRCLE | DIRTY_OUTER_CIRCLE | DIRTY_LAST_POINT,	// PARAM_OUTER_RADIUS
+	DIRTY_CYCLOID | DIRTY_INNER_CIRCLE | DIRTY_LAST_POINT,						// PARAM_CYCLES
+	DIRTY_TRANSFORM | DIRTY_DETAIL,												// PARAM_ROTATION
+	DIRTY_TRANSFORM | DIRTY_DETAIL,												// PARAM_SCALE
+	DIRTY_CYCLOID | DIRTY_INNER_CIRCLE | DIRTY_LAST_POINT,						// PARAM_STEP
+	DIRTY_NONE,																	// PARAM_AMOUNT
+	DIRTY_INNER_CIRCLE | DIRTY_OUTER_CIRCLE,									// PARAM_CIRCLE_DETAIL
+	DIRTY_INNER_CIRCLE,															// PARAM_HIDE_INNER_CIRCLE
+	DIRTY_OUTER_CIRCLE,															// PARAM_HIDE_OUTER_CIRCLE
+	DIRTY_LAST_POINT,															// PARAM_HIDE_DOT
+	DIRTY_NONE,																	// PARAM_PAUSE_ANIMATION
+	DIRTY_ALL,																	// PARAM_VIEW_HYPOCYCLOID
+	DIRTY_NONE,																	// PARAM_ENABLE_POINTS
+	DIRTY_NONE,																	// PARAM_POLYNOMIAL_SCALE
+	DIRTY_TRANSFORM | DIRTY_DETAIL,												// PARAM_OFFSET
+	DIRTY_GALLERY,																// PARAM_VIEW_GALLERY
+	DIRTY_GALLERY,																// PARAM_GALLERY_OUTER_RADII
+	DIRTY_GALLERY,																// PARAM_GALLERY_INNER_RADII
+	DIRTY_GALLERY,																// PARAM_GALLERY_SIZE
+	DIRTY_NONE,																	// PARAM_GALLERY_SAMPLES
+	DIRTY_CYCLOID | DIRTY_INNER_CIRCLE | DIRTY_OUTER_CIRCLE | DIRTY_LAST_POINT |
+		DIRTY_POLYNOMIAL_LINE | DIRTY_DETAIL | DIRTY_CUSTOM_CURVE,				// PARAM_GENERATE_ON_GPU
+	DIRTY_CYCLOID | DIRTY_LAST_POINT | DIRTY_DETAIL,							// PARAM_TRAIL_MODE
+	DIRTY_CYCLOID,																// PARAM_TRAIL_LENGTH
+	DIRTY_CYCLOID | DIRTY_LAST_POINT | DIRTY_DETAIL,							// PARAM_INSTANCE_ARCS
+	DIRTY_CYCLOID | DIRTY_LAST_POINT | DIRTY_DETAIL,							// PARAM_DENSITY_MODE
+	DIRTY_NONE,																	// PARAM_DENSITY_EXPOSURE
+	DIRTY_EPICYCLES,															// PARAM_EPICYCLE_MODE
+	DIRTY_EPICYCLES,															// PARAM_EPICYCLE_TERMS
+	DIRTY_CUSTOM_CURVE,															// PARAM_CUSTOM_CURVE
+	DIRTY_CUSTOM_CURVE,															// PARAM_CUSTOM_RANGE
+	DIRTY_CUSTOM_CURVE,															// PARAM_CUSTOM_SAMPLES
+};
+
+void Program::paramChanged(ParamId param) {
+	dirty |= paramInvalidates[param];
+
+	if (sessionRecorder != nullptr && sessionRecorder->recording()) {
+		size_t size;
+		void* value = paramStorage(param, size);
+		sessionRecorder->record(SessionEvent::PARAM, (uint8_t)param, value, size);
+	}
+}
+
+void* Program::paramStorage(ParamId param, size_t& size) {
+	switch (param) {
+	case PARAM_INNER_RADIUS: size = sizeof(innerRadius); return &innerRadius;
+	case PARAM_OUTER_RADIUS: size = sizeof(outerRadius); return &outerRadius;
+	case PARAM_CYCLES: size = sizeof(cycles); return &cycles;
+	case PARAM_ROTATION: size = sizeof(rotation); return &rotation;
+	case PARAM_SCALE: size = sizeof(scale); return &scale;
+	case PARAM_STEP: size = sizeof(step); return &step;
+	case PARAM_AMOUNT: size = sizeof(amount); return &amount;
+	case PARAM_CIRCLE_DETAIL: size = sizeof(circleDetail); return &circleDetail;
+	case PARAM_HIDE_INNER_CIRCLE: size = sizeof(hideInnerCircle); return &hideInnerCircle;
+	case PARAM_HIDE_OUTER_CIRCLE: size = sizeof(hideOuterCircle); return &hideOuterCircle;
+	case PARAM_HIDE_DOT: size = sizeof(hideDot); return &hideDot;
+	case PARAM_PAUSE_ANIMATION: size = sizeof(pauseAnimation); return &pauseAnimation;
+	case PARAM_VIEW_HYPOCYCLOID: size = sizeof(viewHypocycloid); return &viewHypocycloid;
+	case PARAM_ENABLE_POINTS: size = sizeof(enablePoints); return &enablePoints;
+	case PARAM_POLYNOMIAL_SCALE: size = sizeof(polynomialScale); return &polynomialScale;
+	case PARAM_OFFSET: size = sizeof(offset); return offset;
+	case PARAM_VIEW_GALLERY: size = sizeof(viewGallery); return &viewGallery;
+	case PARAM_GALLERY_OUTER_RADII: size = sizeof(galleryOuterRadii); return galleryOuterRadii;
+	case PARAM_GALLERY_INNER_RADII: size = sizeof(galleryInnerRadii); return galleryInnerRadii;
+	case PARAM_GALLERY_SIZE: size = sizeof(gallerySize); return gallerySize;
+	case PARAM_GALLERY_SAMPLES: size = sizeof(gallerySamples); return &gallerySamples;
+	case PARAM_GENERATE_ON_GPU: size = sizeof(generateOnGpu); return &generateOnGpu;
+	case PARAM_TRAIL_MODE: size = sizeof(trailMode); return &trailMode;
+	case PARAM_TRAIL_LENGTH: size = sizeof(trailLength); return &trailLength;
+	case PARAM_INSTANCE_ARCS: size = sizeof(instanceArcs); return &instanceArcs;
+	case PARAM_DENSITY_MODE: size = sizeof(densityMode); return &densityMode;
+	case PARAM_DENSITY_EXPOSURE: size = sizeof(densityExposure); return &densityExposure;
+	case PARAM_EPICYCLE_MODE: size = sizeof(epicycleMode); return &epicycleMode;
+	case PARAM_EPICYCLE_TERMS: size = sizeof(epicycleTerms); return &epicycleTerms;
+	case PARAM_CUSTOM_CURVE: size = sizeof(viewCustomCurve); return &viewCustomCurve;
+	case PARAM_CUSTOM_RANGE: size = sizeof(customRange); return customRange;
+	case PARAM_CUSTOM_SAMPLES: size = sizeof(customSamples); return &customSamples;
+	default: size = 0; return nullptr;
+	}
+}
+
+void Program::performAction(SessionAction action) {
+	if (sessionRecorder != nullptr && sessionRecorder->recording()) {
+		sessionRecorder->record(SessionEvent::ACTION, (uint8_t)action, nullptr, 0);
+	}
 
-	testObject->verts.push_back(glm::vec3(-5.f, -3.f, 0.f));
-	testObject->verts.push_back(glm::vec3(5.f, -3.f, 0.f));
-	testObject->verts.push_back(glm::vec3(0.f, 5.f, 0.f));
-	renderEngine->assignBuffers(*testObject);
-	renderEngine->updateBuffers(*testObject);
-	geometryObjects.push_back(testObject);
+	switch (action) {
+	case ACTION_REFRESH:
+		parametersChanged = true;
+		dirty = DIRTY_ALL;
+		theta = 0;
+		enablePoints = false;
+		break;
+
+	case ACTION_RESET:
+		outerRadius = 4;
+		innerRadius = 1;
+		cycles = 1;
+		rotation = 0;
+		scale = 1;
+		amount = 1;
+		step = 100;
+		circleDetail = 100;
+		parametersChanged = true;
+		dirty = DIRTY_ALL;
+		hideInnerCircle = false;
+		hideOuterCircle = false;
+		hideDot = false;
+		enablePoints = false;
+		offset[0] = 0;
+		offset[1] = 0;
+
+		theta = 0;
+		break;
+
+	case ACTION_APPLY_POLYNOMIAL_SCALE:
+		applyPolynomialScale = true;
+		break;
+	}
 }
 
+void Program::changeCamera(CameraChange change, const float* values) {
+	static const size_t valueCounts[] = { 2, 3, 0 };
+	if (sessionRecorder != nullptr && sessionRecorder->recording()) {
+		sessionRecorder->record(SessionEvent::CAMERA, (uint8_t)change, values, valueCounts[change] * sizeof(float));
+	}
+
+	switch (change) {
+	case CAMERA_PAN:
+		renderEngine->pan(values[0], values[1]);
+		break;
+
+	case CAMERA_ZOOM:
+		renderEngine->zoomAt(values[0], values[1], values[2]);
+		break;
+
+	case CAMERA_RESET:
+		renderEngine->resetCamera();
+		break;
+	}
+}
+
+void Program::takeCameraMoves(bool replaying) {
+	cameraInput.clear();
+	InputHandler::takeCameraMoves(cameraInput);
+	bool reset = viewResetRequested;
+	viewResetRequested = false;
+	// live scrolling and dragging would change the outcome, only recorded moves count
+	if (replaying) {
+		return;
+	}
+	if (reset) {
+		changeCamera(CAMERA_RESET, nullptr);
+	}
+	for (const InputHandler::CameraMove& move : cameraInput) {
+		float values[3] = { move.x, move.y, move.factor };
+		changeCamera(move.factor == 0.f ? CAMERA_PAN : CAMERA_ZOOM, values);
+	}
+}
+
+void Program::applySessionEvents() {
+	SessionEvent event;
+	while (sessionRecorder->nextEvent(event)) {
+		switch (event.type) {
+		case SessionEvent::PARAM: {
+			size_t size;
+			void* value = paramStorage((ParamId)event.id, size);
+			if (value != nullptr && size == event.size) {
+				memcpy(value, event.data, size);
+				paramChanged((ParamId)event.id);
+			}
+			break;
+		}
+		case SessionEvent::ACTION:
+			performAction((SessionAction)event.id);
+			break;
+		case SessionEvent::CLICK: {
+			float position[2];
+			memcpy(position, event.data, sizeof(position));
+			mousePosition->x = position[0];
+			mousePosition->y = position[1];
+			mousePosition->z = 1;
+			break;
+		}
+		case SessionEvent::STROKE:
+			if (event.id == 0) {
+				float position[2];
+				memcpy(position, event.data, sizeof(position));
+				addEpicycleStrokePoint(glm::vec2(position[0], position[1]));
+			}
+			else {
+				epicycleStrokeEnded = true;
+			}
+			break;
+		case SessionEvent::CAMERA: {
+			float values[3] = {};
+			memcpy(values, event.data, glm::min((size_t)event.size, sizeof(values)));
+			changeCamera((CameraChange)event.id, values);
+			break;
+		}
+		case SessionEvent::EXPRESSION:
+			if (event.id < 2) {
+				replayedCustomText[event.id].append((const char*)event.data, event.size);
+			}
+			else if (event.id == 2) {
+				snprintf(customX, sizeof(customX), "%s", replayedCustomText[0].c_str());
+				snprintf(customY, sizeof(customY), "%s", replayedCustomText[1].c_str());
+				replayedCustomText[0].clear();
+				replayedCustomText[1].clear();
+				compileCustomCurve();
+			}
+			else {
+				int32_t parameter;
+				float value;
+				memcpy(&parameter, event.data, 4);
+				memcpy(&value, event.data + 4, 4);
+				if (parameter >= 0 && (size_t)parameter < customValues.size()) {
+					customValues[parameter] = value;
+					dirty |= DIRTY_CUSTOM_CURVE;
+				}
+			}
+			break;
+		case SessionEvent::RESIZE: {
+			int32_t size[2];
+			memcpy(size, event.data, sizeof(size));
+			glfwSetWindowSize(window, size[0], size[1]);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t b = 0; b < size; b++) {
+		hash = (hash ^ bytes[b]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t Program::geometryHash() {
+	PROFILE_ZONE("geometryHash");
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < scene->size(); i++) {
+		// only buffers written since the last frame are hashed again; what the compute shader made is read back
+		if (scene->contentChanged[i]) {
+			uint64_t content = 14695981039346656037ULL;
+			if (scene->computedCounts[i] > 0) {
+				renderEngine->readComputed(*scene, i, hashInput);
+				content = hashBytes(content, hashInput.data(), hashInput.size() * sizeof(glm::vec3));
+				content = hashBytes(content, &scene->computedCounts[i], sizeof(size_t));
+			}
+			else {
+				const VertexArray& verts = *scene->vertices[i];
+				size_t count = verts.size();
+				content = hashBytes(content, verts.data(), count * sizeof(glm::vec3));
+				content = hashBytes(content, &count, sizeof(count));
+			}
+			scene->contentHashes[i] = content;
+			scene->contentChanged[i] = 0;
+		}
+		hash = hashBytes(hash, &scene->contentHashes[i], sizeof(uint64_t));
+
+		// and which of it is drawn, so reveals and instanced copies count too
+		hash = hashBytes(hash, &scene->firsts[i], sizeof(GLint));
+		hash = hashBytes(hash, &scene->counts[i], sizeof(GLsizei));
+		const DrawRanges& ranges = scene->multiRanges[i];
+		hash = hashBytes(hash, ranges.firsts.data(), ranges.firsts.size() * sizeof(GLint));
+		hash = hashBytes(hash, ranges.counts.data(), ranges.counts.size() * sizeof(GLsizei));
+		const RotatedCopies& rotated = scene->rotatedCopies[i];
+		hash = hashBytes(hash, &rotated.angle, sizeof(rotated.angle));
+		hash = hashBytes(hash, &rotated.firstCopy, sizeof(rotated.firstCopy));
+		hash = hashBytes(hash, &rotated.copies, sizeof(rotated.copies));
+		hash = hashBytes(hash, &rotated.tailCount, sizeof(rotated.tailCount));
+	}
+	return hash;
+}
 
 void Program::drawUI() {
+	PROFILE_ZONE("drawUI");
 	// Start ImGui frame
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
@@ -95,310 +455,957 @@ void Program::drawUI() {
 	{
 		ImGui::Begin("UI Controls");
 
+		glm::vec4 panel = glm::vec4(ImGui::GetWindowPos().x, ImGui::GetWindowPos().y, ImGui::GetWindowSize().x, ImGui::GetWindowSize().y);
+		if (panel != uiPanel) {
+			uiPanel = panel;
+			dirty |= DIRTY_DETAIL;
+		}
+
 		float fontSize = 1.75f;
 		ImGui::SetWindowFontScale(fontSize);
 
 		ImGui::ColorEdit3("clear color", (float*)&clear_color);
 		ImGui::ColorEdit4("line color", (float*)&lineColor);
-		ImGui::DragFloat("small circle radius", (float*)&innerRadius, 0.001f);
-		ImGui::DragFloat("large circle radius", (float*)&outerRadius, 0.001f);
-		ImGui::DragInt("number of cycles", (int*)&cycles);
+		if (ImGui::DragFloat("small circle radius", (float*)&innerRadius, 0.001f)) {
+			paramChanged(PARAM_INNER_RADIUS);
+		}
+		if (ImGui::DragFloat("large circle radius", (float*)&outerRadius, 0.001f)) {
+			paramChanged(PARAM_OUTER_RADIUS);
+		}
+		if (ImGui::DragInt("number of cycles", (int*)&cycles)) {
+			paramChanged(PARAM_CYCLES);
+		}
 		if (cycles < 1) {
 			cycles = 1;
 		}
+		int symmetryOrder, closingCycles;
+		if (CurveGenerator::hypocycloidSymmetry(cycloidParams(), MAX_SYMMETRY_CYCLES, symmetryOrder, closingCycles)) {
+			ImGui::Text("%d-fold symmetric, closes after %d cycles", symmetryOrder, closingCycles);
+		}
 		
-		ImGui::DragFloat("rotation", (float*)&rotation, 0.1f);
-		ImGui::DragFloat("scale factor", (float*)&scale, 0.001f);
-		ImGui::DragInt("hypocycloid resolution", (int*)&step, 1);
+		if (ImGui::DragFloat("rotation", (float*)&rotation, 0.1f)) {
+			paramChanged(PARAM_ROTATION);
+		}
+		if (ImGui::DragFloat("scale factor", (float*)&scale, 0.001f)) {
+			paramChanged(PARAM_SCALE);
+		}
+		if (ImGui::DragInt("hypocycloid resolution", (int*)&step, 1)) {
+			paramChanged(PARAM_STEP);
+		}
 		if (step < 1) {
 			step = 1;
 		}
-		ImGui::DragInt("draws before updating", (int*)&amount, 1);
+		if (ImGui::DragInt("draws before updating", (int*)&amount, 1)) {
+			paramChanged(PARAM_AMOUNT);
+		}
 		if(amount<0) {
 			amount = 0;
 		}
+		if (ImGui::Checkbox("trail mode", (bool*)&trailMode)) {
+			paramChanged(PARAM_TRAIL_MODE);
+		}
+		if (trailMode) {
+			ImGui::SameLine();
+			if (ImGui::DragInt("trail length", (int*)&trailLength, 100, 2, 10000000)) {
+				paramChanged(PARAM_TRAIL_LENGTH);
+			}
+			if (trailLength < 2) {
+				trailLength = 2;
+			}
+		}
+		if (ImGui::Checkbox("density mode", (bool*)&densityMode)) {
+			paramChanged(PARAM_DENSITY_MODE);
+		}
+		if (densityMode) {
+			ImGui::SameLine();
+			if (ImGui::DragFloat("exposure", &densityExposure, 0.1f, 0.01f, 1000.f)) {
+				paramChanged(PARAM_DENSITY_EXPOSURE);
+			}
+		}
+		if (ImGui::Checkbox("epicycle mode", (bool*)&epicycleMode)) {
+			paramChanged(PARAM_EPICYCLE_MODE);
+		}
+		if (epicycleMode) {
+			ImGui::SameLine();
+			if (ImGui::SliderInt("circles", &epicycleTerms, 1, glm::max((int)epicycles.size(), 1))) {
+				paramChanged(PARAM_EPICYCLE_TERMS);
+			}
+			if (epicycles.empty()) {
+				ImGui::Text("Draw a closed path with the left mouse button");
+			}
+		}
+		if (ImGui::Checkbox("custom curve", (bool*)&viewCustomCurve)) {
+			paramChanged(PARAM_CUSTOM_CURVE);
+		}
+		if (viewCustomCurve) {
+			bool edited = ImGui::InputText("x(t)", customX, sizeof(customX));
+			edited |= ImGui::InputText("y(t)", customY, sizeof(customY));
+			if (edited) {
+				customTextChanged();
+			}
+			// the last program that compiled keeps being drawn meanwhile
+			if (!customExpression.error().empty()) {
+				ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "%s", customExpression.error().c_str());
+			}
+			if (ImGui::DragFloatRange2("t range", &customRange[0], &customRange[1], 0.01f)) {
+				paramChanged(PARAM_CUSTOM_RANGE);
+			}
+			if (ImGui::DragInt("custom samples", &customSamples, 100, 2, 1 << 24)) {
+				paramChanged(PARAM_CUSTOM_SAMPLES);
+			}
+			if (customSamples < 2) {
+				customSamples = 2;
+			}
+			// parameters are named by the user, keep them from clashing with the other widgets
+			ImGui::PushID("custom parameters");
+			const std::vector<std::string>& names = customExpression.parameterNames();
+			for (size_t i = 0; i < names.size(); i++) {
+				if (ImGui::DragFloat(names[i].c_str(), &customValues[i], 0.01f)) {
+					customValueChanged(i);
+				}
+			}
+			ImGui::PopID();
+		}
 
 		if (ImGui::Button("refresh")) {
-			parametersChanged = true;
-			theta = 0;
-			thetaCi = 0;
-			thetaCo = 0;
-			enablePoints = false;
+			performAction(ACTION_REFRESH);
 		}
 
 		ImGui::SameLine();
 
 		if (ImGui::Button("reset to defaults")) {
-			outerRadius = 4;
-			innerRadius = 1;
-			cycles = 1;
-			rotation = 0;
-			scale = 1;
-			amount = 1;
-			step = 100;
-			circleDetail = 100;
-			parametersChanged = true;
-			hideInnerCircle = false;
-			hideOuterCircle = false;
-			hideDot = false;
-			enablePoints = false;
-			offset[0] = 0;
-			offset[1] = 0;
+			performAction(ACTION_RESET);
+		}
 
+		ImGui::SameLine();
 
-			theta = 0;
-			thetaCi = 0;
-			thetaCo = 0;
+		if (ImGui::Button("reset view")) {
+			// at the start of the next frame, like the moves, so the geometry of this one is made with the old view
+			viewResetRequested = true;
 		}
 
 		ImGui::SameLine();
 
-		ImGui::Checkbox("pause animation", (bool*)&pauseAnimation);
+		if (ImGui::Checkbox("pause animation", (bool*)&pauseAnimation)) {
+			paramChanged(PARAM_PAUSE_ANIMATION);
+		}
 
 		ImGui::SameLine();
 
-		ImGui::Checkbox("view hypocycloid", (bool*)&viewHypocycloid);
+		if (ImGui::Checkbox("view hypocycloid", (bool*)&viewHypocycloid)) {
+			paramChanged(PARAM_VIEW_HYPOCYCLOID);
+		}
 
-		ImGui::DragInt("circle resolutions", (int*)&circleDetail, 1);
+		if (ImGui::DragInt("circle resolutions", (int*)&circleDetail, 1)) {
+			paramChanged(PARAM_CIRCLE_DETAIL);
+		}
 		if (circleDetail < 1) {
 			circleDetail = 1;
 		}
-		ImGui::Checkbox("hide inner circle", (bool*)&hideInnerCircle);
+		if (ImGui::Checkbox("hide inner circle", (bool*)&hideInnerCircle)) {
+			paramChanged(PARAM_HIDE_INNER_CIRCLE);
+		}
 
 		ImGui::SameLine();
 
-		ImGui::Checkbox("hide outer circle", (bool*)&hideOuterCircle);
+		if (ImGui::Checkbox("hide outer circle", (bool*)&hideOuterCircle)) {
+			paramChanged(PARAM_HIDE_OUTER_CIRCLE);
+		}
 
 		ImGui::SameLine();
 
-		ImGui::Checkbox("hide leading dot", (bool*)&hideDot);
+		if (ImGui::Checkbox("hide leading dot", (bool*)&hideDot)) {
+			paramChanged(PARAM_HIDE_DOT);
+		}
 
 
 
 		if (ImGui::Button("apply scale & translation to points")) {
-			applyPolynomialScale = true;
+			performAction(ACTION_APPLY_POLYNOMIAL_SCALE);
 		}
 
 		ImGui::SameLine();
 
-		ImGui::Checkbox("enable placing control points", (bool*)&enablePoints);
+		if (ImGui::Checkbox("enable placing control points", (bool*)&enablePoints)) {
+			paramChanged(PARAM_ENABLE_POINTS);
+		}
 		if(enablePoints) {
 			mousePosition->z = 0;
 		}
 
-		ImGui::DragFloat("polynomial point scale", (float*)&polynomialScale, 0.001f);
+		if (ImGui::DragFloat("polynomial point scale", (float*)&polynomialScale, 0.001f)) {
+			paramChanged(PARAM_POLYNOMIAL_SCALE);
+		}
+
+		if (ImGui::DragFloat2("translate the model", (float*)&offset, 0.01f)) {
+			paramChanged(PARAM_OFFSET);
+		}
+
+		if (ImGui::Checkbox("view parameter gallery", (bool*)&viewGallery)) {
+			paramChanged(PARAM_VIEW_GALLERY);
+		}
+		if (viewGallery) {
+			if (ImGui::DragFloatRange2("gallery large radii", &galleryOuterRadii[0], &galleryOuterRadii[1], 0.01f)) {
+				paramChanged(PARAM_GALLERY_OUTER_RADII);
+			}
+			if (ImGui::DragFloatRange2("gallery small radii", &galleryInnerRadii[0], &galleryInnerRadii[1], 0.01f)) {
+				paramChanged(PARAM_GALLERY_INNER_RADII);
+			}
+			if (ImGui::DragInt2("gallery columns & rows", gallerySize, 1, 1, 256)) {
+				paramChanged(PARAM_GALLERY_SIZE);
+			}
+			if (ImGui::DragInt("gallery samples per curve", &gallerySamples, 8, 2, 1 << 16)) {
+				paramChanged(PARAM_GALLERY_SAMPLES);
+			}
+		}
+
+		int strategy = renderEngine->getUploadStrategy();
+		const char* strategies[UPLOAD_STRATEGY_COUNT];
+		for (int i = 0; i < UPLOAD_STRATEGY_COUNT; i++) {
+			strategies[i] = RenderEngine::uploadStrategyName((UploadStrategy)i);
+		}
+		if (ImGui::Combo("buffer uploads", &strategy, strategies, UPLOAD_STRATEGY_COUNT)) {
+			if (!renderEngine->setUploadStrategy((UploadStrategy)strategy)) {
+				std::cerr << "This driver doesn't support " << strategies[strategy] << std::endl;
+			}
+		}
+
+		if (ImGui::Checkbox("generate on GPU", (bool*)&generateOnGpu)) {
+			if (generateOnGpu && !renderEngine->computeSupported()) {
+				std::cerr << "This driver doesn't support compute shaders" << std::endl;
+			}
+			paramChanged(PARAM_GENERATE_ON_GPU);
+		}
+		if (ImGui::Checkbox("instance symmetric arcs", (bool*)&instanceArcs)) {
+			paramChanged(PARAM_INSTANCE_ARCS);
+		}
+
+#ifdef HYPO_PROFILE
+		if (ImGui::Button("dump trace")) {
+			PROFILE_DUMP("hypo_trace.json");
+		}
+		ImGui::SameLine();
+#endif
+
+		if (ImGui::Button("export svg")) {
+			exportScene(VectorExporter::SVG);
+		}
 
-		ImGui::DragFloat2("translate the model", (float*)&offset, 0.01f);
+		ImGui::SameLine();
+
+		if (ImGui::Button("export pdf")) {
+			exportScene(VectorExporter::PDF);
+		}
 
 		ImGui::End();
 	}
+
+	hoverCycloid();
+}
+
+void Program::hoverCycloid() {
+	ImGuiIO& io = ImGui::GetIO();
+	if (!viewHypocycloid || viewGallery || io.WantCaptureMouse || cycloidBVH.empty()) {
+		return;
+	}
+
+	// search in the curve's own coordinates, the tree is built before the model matrix is applied
+	glm::dmat4 model = glm::dmat4(scene->modelMatrix(hypocycloid));
+	glm::dvec2 world = renderEngine->screenToWorld(io.MousePos.x, io.MousePos.y) - scene->origin(hypocycloid);
+	glm::vec2 local = glm::vec2(glm::inverse(model) * glm::dvec4(world, 0.0, 1.0));
+	float maxDistance = HOVER_PIXELS * renderEngine->worldPerPixel() / std::fabs(scale);
+
+	// an instanced arc is searched once per revealed copy, with the cursor turned back onto the stored arc
+	size_t copies = 1;
+	size_t lastCount = cycloidRevealed;
+	if (cycloidArc > 0 && cycloidRevealed > 0) {
+		size_t lastCopy, lastVertex;
+		arcPosition(cycloidRevealed - 1, lastCopy, lastVertex);
+		copies = lastCopy + 1;
+		lastCount = lastVertex + 1;
+	}
+
+	bool found = false;
+	float hoverTheta = 0.f;
+	glm::vec2 hoverPoint;
+	for (size_t c = 0; c < copies; c++) {
+		float angle = (float)std::fmod(c * cycloidArc, TWO_PI);
+		glm::vec2 p = glm::vec2(
+			std::cos(angle) * local.x + std::sin(angle) * local.y,
+			-std::sin(angle) * local.x + std::cos(angle) * local.y);
+		size_t limit = c + 1 < copies ? cycloidArcSegments + 1 : lastCount;
+		size_t segment;
+		float t;
+		glm::vec2 point;
+		if (cycloidBVH.nearest(scene->verts(hypocycloid).data(), p, limit, maxDistance, segment, t, point)) {
+			found = true;
+			maxDistance = glm::length(p - point);
+			hoverTheta = (float)(c * cycloidArc + ((double)segment + t) / cycloidSamplesPerRadian());
+			hoverPoint = glm::vec2(
+				std::cos(angle) * point.x - std::sin(angle) * point.y,
+				std::sin(angle) * point.x + std::cos(angle) * point.y);
+		}
+	}
+	if (found) {
+		ImGui::BeginTooltip();
+		ImGui::Text("theta %.4f", hoverTheta);
+		ImGui::Text("x %.4f  y %.4f", hoverPoint.x, hoverPoint.y);
+		ImGui::EndTooltip();
+	}
+}
+
+void Program::updateTransforms() {
+	// scale or rotate the hypocycloid, the circles and the leading dot together
+	glm::mat4 model = glm::mat4(1.f);
+	model = glm::translate(model, glm::vec3(offset[0], offset[1], 0.0f));
+	model = glm::scale(model, glm::vec3(scale));
+	model = glm::rotate(model, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+
+	scene->modelMatrix(hypocycloid) = model;
+	scene->modelMatrix(outerCircle) = model;
+	scene->modelMatrix(lastPoint) = model;
+
+	// the inner circle is generated around the origin and moved to where it touches the outer one
+	float radiusDif = (outerRadius - innerRadius);
+	glm::vec3 center = glm::vec3(radiusDif * cos(theta), radiusDif * sin(theta), 0.f);
+	scene->modelMatrix(innerCircle) = glm::translate(model, center);
+
+	// the polynomial gets its translation baked into the points instead
+	glm::mat4 polynomialModel = glm::mat4(1.f);
+	polynomialModel = glm::scale(polynomialModel, glm::vec3(scale));
+	polynomialModel = glm::rotate(polynomialModel, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+
+	scene->modelMatrix(polynomialPoints) = polynomialModel;
+	scene->modelMatrix(polynomialLine) = polynomialModel;
+}
+
+void Program::exportScene(VectorExporter::Format format) {
+	const char* path = format == VectorExporter::SVG ? "hypocycloid.svg" : "hypocycloid.pdf";
+	int width, height;
+	glfwGetWindowSize(window, &width, &height);
+	if (width <= 0 || height <= 0) {
+		std::cerr << "Nothing to export while the window is minimized" << std::endl;
+		return;
+	}
+
+	// same view as the camera, so the file matches the screen; like on screen, everything is placed relative to
+	// the camera center so a deep zoom doesn't come out in float steps
+	glm::dvec2 viewMin, viewMax;
+	renderEngine->visibleBounds(viewMin, viewMax);
+	glm::dvec2 center = renderEngine->viewCenter();
+	VectorExporter exporter;
+	if (!exporter.begin(path, format, width, height, glm::vec2(viewMin - center), glm::vec2(viewMax - center))) {
+		std::cerr << "Could not open " << path << std::endl;
+		return;
+	}
+	// curves made by the compute shader only exist on the GPU
+	if (computeGeneration()) {
+		renderEngine->readBack(*scene, hypocycloid);
+		renderEngine->readBack(*scene, innerCircle);
+		renderEngine->readBack(*scene, outerCircle);
+		renderEngine->readBack(*scene, polynomialLine);
+		renderEngine->readBack(*scene, customCurve);
+	}
+
+	glm::vec4 color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
+	for (size_t i = 0; i < scene->size(); i++) {
+		if (scene->drawModes[i] == GL_POINTS || scene->counts[i] == 0) {
+			continue;
+		}
+		glm::mat4 model = renderEngine->cameraRelative(scene->origins[i]) * scene->modelMatrices[i];
+		// only what is on screen, e.g. the part of the curve revealed so far
+		const VertexArray& verts = *scene->vertices[i];
+		const DrawRanges& ranges = scene->multiRanges[i];
+		const RotatedCopies& rotated = scene->rotatedCopies[i];
+		size_t rangeCount = ranges.firsts.empty() ? 1 : ranges.firsts.size();
+		size_t copyCount = rotated.copies + (rotated.tailCount > 0 ? 1 : 0);
+		for (size_t c = 0; c < copyCount; c++) {
+			// instanced arcs come out as one path per copy, the file doesn't know about instancing
+			double angle = std::fmod((rotated.firstCopy + c) * rotated.angle, TWO_PI);
+			glm::mat4 copyModel = glm::rotate(model, (float)angle, glm::vec3(0.f, 0.f, 1.f));
+			for (size_t r = 0; r < rangeCount; r++) {
+				size_t first = ranges.firsts.empty() ? scene->firsts[i] : ranges.firsts[r];
+				size_t count = ranges.firsts.empty() ? scene->counts[i] : ranges.counts[r];
+				if (c == (size_t)rotated.copies) {
+					count = glm::min(count, (size_t)rotated.tailCount);
+				}
+				first = glm::min(first, verts.size());
+				exporter.beginPath(copyModel, color);
+				exporter.points(verts.data() + first, glm::min(count, verts.size() - first));
+				exporter.endPath();
+			}
+		}
+	}
+	if (!exporter.end()) {
+		std::cerr << "Failed writing " << path << std::endl;
+		return;
+	}
+	std::cout << "Exported " << path << std::endl;
+}
+
+bool Program::computeGeneration() const {
+	return generateOnGpu && renderEngine->computeSupported();
+}
+
+bool Program::isAnimating() const {
+	if (densityMode) {
+		return viewHypocycloid && !pauseAnimation && densitySamples < cycloidSampleCount();
+	}
+	if (trailMode) {
+		return viewHypocycloid && !pauseAnimation && amount > 0;
+	}
+	return viewHypocycloid && !pauseAnimation && !cycloidPending && amount > 0 && cycloidRevealed < cycloidSampleCount();
 }
 
 void Program::createCycloid() {
-	hypocycloid = new Geometry;
-	renderEngine->assignBuffers(*hypocycloid);
-	updateCycloid();
-	geometryObjects.push_back(hypocycloid);
+	hypocycloid = scene->create();
+	renderEngine->assignBuffers(*scene, hypocycloid);
+	cycloidDetail = scene->create();
+	renderEngine->assignBuffers(*scene, cycloidDetail);
+}
+
+CurveParams Program::cycloidParams() const {
+	CurveParams params;
+	params.outerRadius = outerRadius;
+	params.innerRadius = innerRadius;
+	params.step = step;
+	return params;
+}
+
+size_t Program::cycloidSampleCount() const {
+	return CurveGenerator::hypocycloidSampleCount(cycloidParams(), cycles);
+}
+
+glm::dmat3 Program::cycloidTransform(glm::dvec2 anchor) const {
+	double angle = glm::radians((double)rotation);
+	double c = std::cos(angle) * scale;
+	double s = std::sin(angle) * scale;
+	return glm::dmat3(
+		c, s, 0.0,
+		-s, c, 0.0,
+		offset[0] - anchor.x, offset[1] - anchor.y, 1.0);
+}
+
+double Program::cycloidSamplesPerRadian() const {
+	return cycloidArc > 0 ? cycloidArcSegments / cycloidArc : (double)step;
+}
+
+bool Program::cycloidArcSplit(double& angle, size_t& segments) const {
+	angle = 0.0;
+	segments = 0;
+	if (!instanceArcs) {
+		return false;
+	}
+	// only if there are at least two copies, each long enough that drawing it as an instance pays off
+	double arc = CurveGenerator::hypocycloidArcAngle(cycloidParams());
+	if (arc <= 0 || 2 * arc > 2 * (double)PI * cycles) {
+		return false;
+	}
+	size_t arcSegments = (size_t)std::ceil(arc * step);
+	if (arcSegments < MIN_ARC_SEGMENTS) {
+		return false;
+	}
+	angle = arc;
+	segments = arcSegments;
+	return true;
+}
+
+void Program::arcPosition(size_t sample, size_t& copy, size_t& vertex) const {
+	// the animation counts samples of the whole curve, the arc is sampled a little differently so the nearest
+	// of its vertices stands in
+	double sampleTheta = (double)sample / step;
+	copy = (size_t)std::floor(sampleTheta / cycloidArc);
+	double along = (sampleTheta - copy * cycloidArc) / cycloidArc * cycloidArcSegments;
+	vertex = glm::min((size_t)(along + 0.5), cycloidArcSegments);
+}
+
+void Program::showRevealed() {
+	RotatedCopies& copies = scene->copies(hypocycloid);
+	if (cycloidArc <= 0) {
+		// nothing is uploaded, the curve is already on the GPU in full
+		scene->setDrawRange(hypocycloid, 0, (GLsizei)cycloidRevealed);
+		copies = RotatedCopies();
+		return;
+	}
+
+	// whole copies of the arc up to the one the animation is on, which is only drawn as far as it got
+	size_t copy = 0;
+	size_t vertex = 0;
+	if (cycloidRevealed > 0) {
+		arcPosition(cycloidRevealed - 1, copy, vertex);
+	}
+	scene->setDrawRange(hypocycloid, 0, cycloidRevealed > 0 ? (GLsizei)(cycloidArcSegments + 1) : 0);
+	copies.angle = cycloidArc;
+	copies.firstCopy = 0;
+	copies.copies = (GLsizei)copy;
+	copies.tailCount = (GLsizei)vertex + 1;
+}
+
+void Program::revealCycloid() {
+	// an arc stands for the whole curve
+	size_t available = cycloidArc > 0 ? cycloidSampleCount() : glm::max(scene->verts(hypocycloid).size(), computedCycloidSamples);
+	cycloidRevealed = glm::min(cycloidRevealed, available);
+	theta = cycloidRevealed > 0 ? CurveGenerator::hypocycloidTheta(cycloidParams(), cycloidRevealed - 1) : 0;
+
+	showRevealed();
+	updateLastPoint();
+	dirty |= DIRTY_TRANSFORM | DIRTY_DETAIL;
 }
 
-int resumeValue = 1;
 void Program::updateCycloid() {
-	if(parametersChanged){
-		hypocycloid->verts.clear();
+	PROFILE_ZONE("updateCycloid");
+	if (densityMode) {
+		updateDensity();
+		return;
 	}
-	if (theta > (PI * 2 * cycles) || pauseAnimation) {
-		if(amount>0) {
-			resumeValue = amount;
-		}
-		amount = 0;
+	if (trailMode) {
+		updateTrail();
+		return;
 	}
-	else {
-		if (amount == 0) {
-			amount = resumeValue;
+	if (dirty & DIRTY_CYCLOID) {
+		// keep the animation at the same angle, the new curve is generated in full in the background
+		// while the old one stays up
+		size_t total = cycloidSampleCount();
+		cycloidStoreDue = false;
+		if (cycloidRevealed > 0) {
+			cycloidRevealed = glm::min(total, (size_t)(theta * step + 0.5f) + 1);
 		}
 
-	}
-	// draw the hypocycloid
-	for (int x = 0; x < amount; x++){
-		if (theta < (PI * 2 * cycles)) {
-			theta += (float)1 / (float)step;
+		if (computeGeneration()) {
+			// fast enough to do in place, and there is no CPU copy to cache or cull with
+			curveWorker->cancel();
+			cycloidPending = false;
+			cycloidBVH.clear();
+			cycloidArc = 0.0;
+			cycloidArcSegments = 0;
+			renderEngine->computeHypocycloid(*scene, hypocycloid, cycloidParams(), total);
+			drawnCycloid.reset();
+			computedCycloidSamples = total;
+			revealCycloid();
+			return;
 		}
 
-		float radiusDif = (outerRadius - innerRadius);
-		float ratio = ((radiusDif / innerRadius) / innerRadius) * theta;
-		hypocycloid->verts.push_back(glm::vec3(
-			(radiusDif*cos(theta) + innerRadius * cos(ratio)),
-			(radiusDif*sin(theta) - innerRadius * sin(ratio)),
-			0.f));
-	}
+		// A curve of congruent arcs only needs one of them, the rest are rotated copies drawn as instances.
+		// That is a fraction of the samples, not worth caching.
+		double samplesPerRadian = step;
+		size_t count = total;
+		if (cycloidArcSplit(requestedArc, requestedArcSegments)) {
+			samplesPerRadian = requestedArcSegments / requestedArc;
+			count = requestedArcSegments + 1;
+		}
+		else {
+			cachedCycloid = curveCache->load(cycloidParams());
+			if (cachedCycloid && cachedCycloid->count() >= total) {
+				// drawn straight from the mapping, culling and picking wait for the BVH the worker builds over it
+				computedCycloidSamples = 0;
+				cycloidArc = 0.0;
+				cycloidArcSegments = 0;
+				cycloidBVH.clear();
+				drawnCycloid = cachedCycloid;
+				scene->verts(hypocycloid).borrow(drawnCycloid->vertices(), total);
+				renderEngine->updateBuffers(*scene, hypocycloid);
+				revealCycloid();
+
+				cycloidGeneration = curveWorker->request(drawnCycloid, total);
+				cycloidPending = true;
+				if (sessionRecorder != nullptr && sessionRecorder->replaying()) {
+					receiveCycloid(curveWorker->waitForResult(cycloidGeneration));
+				}
+				return;
+			}
+		}
 
-	// scale or rotate the hypocycloid
-	hypocycloid->modelMatrix = glm::mat4(1.f);
-	hypocycloid->modelMatrix = glm::translate(hypocycloid->modelMatrix, glm::vec3(offset[0], offset[1], 0.0f));
-	hypocycloid->modelMatrix = glm::scale(hypocycloid->modelMatrix, glm::vec3(scale));
-	hypocycloid->modelMatrix = glm::rotate(hypocycloid->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+		cycloidGeneration = curveWorker->request(cycloidParams(), count, samplesPerRadian);
+		cycloidPending = true;
+		// replays can't depend on how fast the worker happens to be
+		if (sessionRecorder != nullptr && sessionRecorder->replaying()) {
+			receiveCycloid(curveWorker->waitForResult(cycloidGeneration));
+		}
+		return;
+	}
 
-	renderEngine->updateBuffers(*hypocycloid);
+	// animating only draws a few more of the samples that are already uploaded
+	cycloidRevealed = glm::min(cycloidRevealed + (size_t)amount, cycloidSampleCount());
+	revealCycloid();
 }
 
-void Program::createInnerCircle(){
-	innerCircle = new Geometry;
-	renderEngine->assignBuffers(*innerCircle);
-	updateInnerCircle();
-	geometryObjects.push_back(innerCircle);
+void Program::updateTrail() {
+	if (dirty & DIRTY_CYCLOID) {
+		// none of the full curve is kept, the trail starts over from the current angle with the new shape
+		clearCycloid();
+
+		if (renderEngine->getTrailCapacity() != (size_t)trailLength) {
+			renderEngine->setTrailCapacity(trailLength);
+		}
+		else {
+			renderEngine->clearTrail();
+		}
+		trailIndex = (size_t)(theta * step + 0.5f);
+	}
+
+	if (pauseAnimation || amount <= 0) {
+		return;
+	}
+	// a frame can't show more than the trail holds, so only the newest samples are generated
+	size_t count = glm::min((size_t)amount, (size_t)trailLength);
+	trailSamples.resize(count);
+	CurveGenerator::hypocycloid(cycloidParams(), trailIndex + amount - count, count, trailSamples.data());
+	renderEngine->appendTrail(trailSamples.data(), count);
+
+	trailIndex += amount;
+	theta = CurveGenerator::hypocycloidTheta(cycloidParams(), trailIndex - 1);
+	dirty |= DIRTY_TRANSFORM;
 }
 
-void Program::createOuterCircle() {
-	outerCircle = new Geometry;
-	renderEngine->assignBuffers(*outerCircle);
-	updateOuterCircle();
-	geometryObjects.push_back(outerCircle);
+void Program::clearCycloid() {
+	curveWorker->cancel();
+	cycloidPending = false;
+	cycloidBVH.clear();
+	computedCycloidSamples = 0;
+	cycloidRevealed = 0;
+	cycloidArc = 0.0;
+	cycloidArcSegments = 0;
+	scene->copies(hypocycloid) = RotatedCopies();
+	scene->verts(hypocycloid).clear();
+	drawnCycloid.reset();
+	renderEngine->updateBuffers(*scene, hypocycloid);
+	updateLastPoint();
 }
 
+void Program::updateDensity() {
+	PROFILE_ZONE("updateDensity");
+	if (dirty & DIRTY_CYCLOID) {
+		clearCycloid();
+		densitySamples = 0;
+	}
+
+	// one pixel per window pixel; anything that moves the curve on screen starts the counts over
+	int width, height;
+	glfwGetWindowSize(window, &width, &height);
+	glm::dvec2 center = renderEngine->viewCenter();
+	double pixelsPerUnit = 1.0 / renderEngine->worldPerPixel();
+	glm::dmat3 toWindow = glm::dmat3(
+		pixelsPerUnit, 0.0, 0.0,
+		0.0, -pixelsPerUnit, 0.0,
+		width * 0.5, height * 0.5, 1.0);
+	glm::dmat3 toPixels = toWindow * cycloidTransform(center);
+	if (width != densityMap.width() || height != densityMap.height()) {
+		densityMap.resize(width, height);
+		densityImage.resize((size_t)width * height);
+		densitySamples = 0;
+	}
+	else if (toPixels != densityToPixels || densitySamples == 0) {
+		densityMap.clear();
+		densitySamples = 0;
+	}
+	densityToPixels = toPixels;
+
+	// a slice of the curve per frame, straight from the generator, so the picture fills in while staying responsive
+	size_t total = cycloidSampleCount();
+	bool binned = false;
+	if (!pauseAnimation && densitySamples < total) {
+		size_t count = glm::min(DENSITY_SAMPLES_PER_FRAME, total - densitySamples);
+		densityMap.accumulate(*threadPool, cycloidParams(), toPixels, densitySamples, count);
+		densitySamples += count;
+		binned = true;
+
+		// the inner circle rolls along to where the binning got to
+		theta = CurveGenerator::hypocycloidTheta(cycloidParams(), densitySamples - 1);
+		dirty |= DIRTY_TRANSFORM;
+	}
+	if (binned || densityExposure != densityShownExposure) {
+		densityMap.toneMap(*threadPool, densityExposure, densityImage.data());
+		renderEngine->setDensityImage(width, height, densityImage.data());
+		densityShownExposure = densityExposure;
+	}
+}
 
+size_t Program::cycloidSubdivisions() const {
+	double segmentLength = CurveGenerator::hypocycloidSpeed(cycloidParams()) * std::fabs(scale) / cycloidSamplesPerRadian();
+	double pixels = segmentLength / renderEngine->worldPerPixel();
+	// fine sample indices have to stay exact in double
+	double limit = MAX_EXACT_INDEX / (double)glm::max(cycloidSampleCount(), (size_t)1);
+	return (size_t)glm::clamp(std::ceil(pixels / DETAIL_PIXELS), 1.0, limit);
+}
 
-void Program::updateInnerCircle() {
-	innerCircle->verts.clear();
-	
-	if (hideInnerCircle) {
+void Program::updateCycloidDetail() {
+	PROFILE_ZONE("updateCycloidDetail");
+	VertexArray& detail = scene->verts(cycloidDetail);
+	const VertexArray& verts = scene->verts(hypocycloid);
+	size_t revealed = glm::min(cycloidRevealed, verts.size());
+	size_t subdivisions = cycloidSubdivisions();
+	detail.clear();
+	detailFirsts.clear();
+	detailCounts.clear();
+
+	// culling and refinement work from the CPU copy, a curve made on the GPU is drawn as it is
+	if (cycloidBVH.empty()) {
+		renderEngine->updateBuffers(*scene, cycloidDetail);
 		return;
 	}
 
-	// draw the inner circle
-	for (int x = 0; x < (PI * 2 * circleDetail) + 1; x++) {
-		thetaCi += (float) 1 / (float) circleDetail;
-		if (thetaCi > (PI * 2)) {
-			thetaCi = 0;
+	// base segments whose box, grown by how far the arc can stray from its chord, touches the view and isn't
+	// entirely under the UI panel
+	// the boxes are compared relative to the camera center, where float still resolves the view
+	glm::mat4 model = renderEngine->cameraRelative(scene->origin(hypocycloid)) * scene->modelMatrix(hypocycloid);
+	glm::dvec2 center = renderEngine->viewCenter();
+	glm::dvec2 viewLow, viewHigh;
+	renderEngine->visibleBounds(viewLow, viewHigh);
+	glm::vec2 viewMin = glm::vec2(viewLow - center);
+	glm::vec2 viewMax = glm::vec2(viewHigh - center);
+	glm::vec2 panelCorner = glm::vec2(renderEngine->screenToWorld(uiPanel.x, uiPanel.y) - center);
+	glm::vec2 panelOpposite = glm::vec2(renderEngine->screenToWorld(uiPanel.x + uiPanel.z, uiPanel.y + uiPanel.w) - center);
+	glm::vec2 hiddenMin = glm::min(panelCorner, panelOpposite);
+	glm::vec2 hiddenMax = glm::max(panelCorner, panelOpposite);
+	float margin = (float)(CurveGenerator::hypocycloidSpeed(cycloidParams()) * std::fabs(scale) / cycloidSamplesPerRadian());
+	if (cycloidArc > 0 && cycloidRevealed > 0) {
+		// every revealed copy of an instanced arc is culled on its own, and its runs are numbered along the
+		// unrolled curve, where copy c starts c whole arcs in
+		size_t lastCopy, lastVertex;
+		arcPosition(cycloidRevealed - 1, lastCopy, lastVertex);
+		for (size_t c = 0; c <= lastCopy; c++) {
+			float angle = (float)std::fmod(c * cycloidArc, TWO_PI);
+			glm::mat4 copyModel = glm::rotate(model, angle, glm::vec3(0.f, 0.f, 1.f));
+			size_t limit = c < lastCopy ? cycloidArcSegments + 1 : lastVertex + 1;
+			arcFirsts.clear();
+			arcCounts.clear();
+			cycloidBVH.visibleRanges(copyModel, viewMin, viewMax, hiddenMin, hiddenMax, margin, limit, arcFirsts, arcCounts);
+			for (size_t r = 0; r < arcFirsts.size(); r++) {
+				detailFirsts.push_back((GLint)(c * cycloidArcSegments) + arcFirsts[r]);
+				detailCounts.push_back(arcCounts[r]);
+			}
 		}
-		innerCircle->verts.push_back(glm::vec3(
-			innerRadius*(cos(thetaCi)) + (outerRadius - innerRadius) * cos(theta),
-			innerRadius*(sin(thetaCi)) + (outerRadius - innerRadius) * sin(theta),
-			0.f));
+	}
+	else if (cycloidArc <= 0) {
+		cycloidBVH.visibleRanges(model, viewMin, viewMax, hiddenMin, hiddenMax, margin, revealed, detailFirsts, detailCounts);
 	}
 
-	// scale or rotate the inner circle
-	innerCircle->modelMatrix = glm::mat4(1.f);
-	innerCircle->modelMatrix = glm::translate(innerCircle->modelMatrix, glm::vec3(offset[0], offset[1], 0.0f));
-	innerCircle->modelMatrix = glm::scale(innerCircle->modelMatrix, glm::vec3(scale));
-	innerCircle->modelMatrix = glm::rotate(innerCircle->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+	// From here on in double: the model matrix, then a shift to the camera center so the floats that get
+	// uploaded only have to resolve the view, not the whole world
+	glm::dvec2 anchor = renderEngine->viewCenter();
+	glm::dmat3 transform = cycloidTransform(anchor);
+	glm::dvec2 reach = renderEngine->viewHalfSize() + (double)(DETAIL_PIXELS * renderEngine->worldPerPixel());
+
+	// Only the stretches of the visible base segments that actually pass through the view get fine samples,
+	// which is what keeps a deep zoom affordable. Past the budget, give up smoothness rather than frame rate.
+	size_t total = 0;
+	while (subdivisions > 1) {
+		detailSampleFirsts.clear();
+		detailSampleCounts.clear();
+		double samplesPerRadian = cycloidSamplesPerRadian() * subdivisions;
+		for (size_t r = 0; r < detailFirsts.size(); r++) {
+			size_t first = (size_t)detailFirsts[r] * subdivisions;
+			size_t last = ((size_t)detailFirsts[r] + detailCounts[r] - 1) * subdivisions;
+			CurveGenerator::hypocycloidVisible(cycloidParams(), samplesPerRadian, transform, -reach, reach, first, last,
+				DETAIL_GRAIN, detailSampleFirsts, detailSampleCounts);
+		}
+		total = 0;
+		for (size_t r = 0; r < detailSampleCounts.size(); r++) {
+			total += detailSampleCounts[r];
+		}
+		if (total <= MAX_DETAIL_SAMPLES) {
+			break;
+		}
+		subdivisions = subdivisions * MAX_DETAIL_SAMPLES / total;
+	}
 
-	renderEngine->updateBuffers(*innerCircle);
+	if (subdivisions <= 1) {
+		// the base curve is fine as it is, it only needs the parts in view; the runs of instanced copies don't
+		// exist in its buffer though, so those are drawn whole
+		renderEngine->updateBuffers(*scene, cycloidDetail);
+		if (cycloidArc > 0) {
+			showRevealed();
+		}
+		else {
+			scene->setDrawRanges(hypocycloid, detailFirsts.data(), detailCounts.data(), detailFirsts.size());
+		}
+		return;
+	}
+
+	double samplesPerRadian = cycloidSamplesPerRadian() * subdivisions;
+	detail.resize(total);
+	detailFirsts.resize(detailSampleFirsts.size());
+	detailCounts.resize(detailSampleCounts.size());
+
+	size_t written = 0;
+	for (size_t r = 0; r < detailSampleFirsts.size(); r++) {
+		size_t first = detailSampleFirsts[r];
+		size_t count = detailSampleCounts[r];
+		glm::vec3* out = detail.data() + written;
+		threadPool->parallelFor(count, CurveGenerator::CHUNK_SIZE, [&](size_t begin, size_t end) {
+			CurveGenerator::hypocycloid(cycloidParams(), samplesPerRadian, transform, first + begin, end - begin, out + begin);
+		});
+		detailFirsts[r] = (GLint)written;
+		detailCounts[r] = (GLsizei)count;
+		written += count;
+	}
+
+	// the transform is baked in, all that is left is where the coordinates are relative to
+	scene->modelMatrix(cycloidDetail) = glm::mat4(1.f);
+	scene->origin(cycloidDetail) = anchor;
+	renderEngine->updateBuffers(*scene, cycloidDetail);
+	scene->setDrawRanges(cycloidDetail, detailFirsts.data(), detailCounts.data(), detailFirsts.size());
+	// everything on screen is covered by the detail strips
+	scene->setDrawRange(hypocycloid, 0, 0);
+	scene->copies(hypocycloid) = RotatedCopies();
 }
 
-void Program::updateOuterCircle() {
-	if (hideOuterCircle) {
-		outerCircle->verts.clear();
+void Program::storeCycloid() {
+	if (!cycloidStoreDue) {
 		return;
 	}
-	if (parametersChanged) {
-		outerCircle->verts.clear();
+	size_t count = scene->verts(hypocycloid).size();
+	double current = std::chrono::duration<double>(std::chrono::steady_clock::now() - cycloidCurrentSince).count();
+	if (count < STORE_AT_ONCE_SAMPLES && current < STORE_DELAY) {
+		return;
+	}
+	// drop the old mapping first, Windows won't replace a file that is still mapped
+	cachedCycloid.reset();
+	curveWorker->store(cycloidParams(), count);
+	cycloidStoreDue = false;
+}
+
+void Program::receiveCycloid(CurveResult* result) {
+	PROFILE_ZONE("receiveCycloid");
+	if (result == nullptr) {
+		return;
 	}
 
-	// draw the outer circle
-	for (int x = 0; x < (PI * 2 * circleDetail) + 1; x++) {
-		thetaCo += (float) 1 / (float) circleDetail;
-		if (thetaCo > (PI * 2)) {
-			thetaCo = 0;
+	// results of requests that were superseded in the meantime are dropped
+	if (cycloidPending && result->generation == cycloidGeneration) {
+		// a cached curve is already up, only its BVH was missing
+		if (!result->cached) {
+			VertexArray& verts = scene->verts(hypocycloid);
+			// lets go of a cached curve's mapping before swapping, so the worker never sees it
+			verts.clear();
+			verts.swap(result->verts);
+			drawnCycloid.reset();
+			computedCycloidSamples = 0;
+			cycloidArc = requestedArc;
+			cycloidArcSegments = requestedArcSegments;
+			cycloidStoreDue = cycloidArc <= 0 && verts.size() == cycloidSampleCount()
+				&& !(cachedCycloid && cachedCycloid->count() >= verts.size());
+			cycloidCurrentSince = std::chrono::steady_clock::now();
+			renderEngine->updateBuffers(*scene, hypocycloid);
 		}
-		outerCircle->verts.push_back(glm::vec3(
-			outerRadius*(cos(thetaCo)),
-			outerRadius*(sin(thetaCo)),
-			0.f));
+		cycloidBVH.swap(result->bvh);
+		cycloidPending = false;
+		revealCycloid();
 	}
-	// scale or rotate the outer circle
-	outerCircle->modelMatrix = glm::mat4(1.f);
-	outerCircle->modelMatrix = glm::translate(outerCircle->modelMatrix, glm::vec3(offset[0], offset[1], 0.0f));
-	outerCircle->modelMatrix = glm::scale(outerCircle->modelMatrix, glm::vec3(scale));
-	outerCircle->modelMatrix = glm::rotate(outerCircle->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+	curveWorker->recycle(result);
+}
 
-	renderEngine->updateBuffers(*outerCircle);
+void Program::createInnerCircle(){
+	innerCircle = scene->create();
+	renderEngine->assignBuffers(*scene, innerCircle);
 }
 
-void Program::createLastPoint() {
-	lastPoint = new Geometry;
-	lastPoint->drawMode = GL_POINTS;
-	renderEngine->assignBuffers(*lastPoint);
-	updateLastPoint();
-	geometryObjects.push_back(lastPoint);
+void Program::createOuterCircle() {
+	outerCircle = scene->create();
+	renderEngine->assignBuffers(*scene, outerCircle);
 }
 
-void Program::updateLastPoint() {
-	lastPoint->verts.clear();
-	if(hideDot)	{
+
+
+void Program::updateInnerCircle() {
+	VertexArray& verts = scene->verts(innerCircle);
+	verts.clear();
+	
+	if (!hideInnerCircle && computeGeneration()) {
+		renderEngine->computeCircle(*scene, innerCircle, glm::vec3(0.f), innerRadius, circleDetail);
 		return;
 	}
+	if (!hideInnerCircle) {
+		// around the origin, updateTransforms moves it along with the curve
+		verts.resize(CurveGenerator::circleSampleCount(circleDetail));
+		CurveGenerator::circle(*threadPool, glm::vec3(0.f), innerRadius, circleDetail, verts.data());
+	}
 
-	float radiusDif = (outerRadius - innerRadius);
-	float ratio = ((radiusDif / innerRadius) / innerRadius) * theta;
-	lastPoint->verts.push_back(glm::vec3(
-		(radiusDif*cos(theta) + innerRadius * cos(ratio)),
-		(radiusDif*sin(theta) - innerRadius * sin(ratio)),
-		0.f));
+	renderEngine->updateBuffers(*scene, innerCircle);
+}
 
-	// scale or rotate the line indicator point with everything else
-	lastPoint->modelMatrix = glm::mat4(1.f);
-	lastPoint->modelMatrix = glm::translate(lastPoint->modelMatrix, glm::vec3(offset[0], offset[1], 0.0f));
-	lastPoint->modelMatrix = glm::scale(lastPoint->modelMatrix, glm::vec3(scale));
-	lastPoint->modelMatrix = glm::rotate(lastPoint->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+void Program::updateOuterCircle() {
+	VertexArray& verts = scene->verts(outerCircle);
+	verts.clear();
 
-	renderEngine->updateBuffers(*lastPoint);
+	if (!hideOuterCircle && computeGeneration()) {
+		renderEngine->computeCircle(*scene, outerCircle, glm::vec3(0.f), outerRadius, circleDetail);
+		return;
+	}
+	if (!hideOuterCircle) {
+		// draw the outer circle
+		verts.resize(CurveGenerator::circleSampleCount(circleDetail));
+		CurveGenerator::circle(*threadPool, glm::vec3(0.f), outerRadius, circleDetail, verts.data());
+	}
+
+	renderEngine->updateBuffers(*scene, outerCircle);
+}
+
+void Program::createLastPoint() {
+	// the dot is just the last revealed sample of the curve's own buffer
+	lastPoint = scene->create(GL_POINTS);
+	renderEngine->shareBuffers(*scene, lastPoint, hypocycloid);
+}
+
+void Program::updateLastPoint() {
+	bool visible = !hideDot && cycloidRevealed > 0;
+	size_t vertex = visible ? cycloidRevealed - 1 : 0;
+	RotatedCopies copies;
+	if (visible && cycloidArc > 0) {
+		// the vertex on the copy of the arc the animation is on
+		size_t copy;
+		arcPosition(cycloidRevealed - 1, copy, vertex);
+		copies.angle = cycloidArc;
+		copies.firstCopy = (GLint)copy;
+	}
+	scene->copies(lastPoint) = copies;
+	scene->setDrawRange(lastPoint, (GLint)vertex, visible ? 1 : 0);
 }
 
 void Program::createPolynomial(){
-	polynomialPoints = new Geometry;
-	polynomialLine = new Geometry;
-	polynomialPoints->drawMode = GL_POINTS;
-	renderEngine->assignBuffers(*polynomialPoints);
-	renderEngine->assignBuffers(*polynomialLine);
-	updatePolynomialPoints();
-	updatePolynomialLines();
-	geometryObjects.push_back(polynomialPoints);
-	geometryObjects.push_back(polynomialLine);
+	polynomialPoints = scene->create(GL_POINTS);
+	polynomialLine = scene->create();
+	renderEngine->assignBuffers(*scene, polynomialPoints);
+	renderEngine->assignBuffers(*scene, polynomialLine);
 }
 
 //Keeps track of how many mouse clicks there were
 int pointCounter = 0;
 void Program::updatePolynomialLines() {
+	PROFILE_ZONE("updatePolynomialLines");
 
-	polynomialLine->verts.clear();
+	VertexArray& verts = scene->verts(polynomialLine);
+	const VertexArray& points = scene->verts(polynomialPoints);
+	verts.clear();
 
 	float polyLineStep = 0.0001;
-	float uValue = 0;
+	if (pointCounter > 2 && computeGeneration()) {
+		renderEngine->computeQuadratic(*scene, polynomialLine, points[0], points[1], points[2], polyLineStep);
+		return;
+	}
 	if(pointCounter>2)	{
-		while (uValue<=1){
-			glm::vec3 curveValues = polynomialPoints->verts[0] + polynomialPoints->verts[1] * glm::vec1(uValue) + polynomialPoints->verts[2] * glm::vec1(uValue * uValue);
-			polynomialLine->verts.push_back(curveValues);
-
-			// Update uValue
-			uValue+=polyLineStep;
-		}
+		verts.resize(CurveGenerator::quadraticSampleCount(polyLineStep));
+		CurveGenerator::quadratic(*threadPool, points[0], points[1], points[2], polyLineStep, verts.data());
 	}
-	polynomialLine->modelMatrix = glm::mat4(1.f);
-	polynomialLine->modelMatrix = glm::scale(polynomialLine->modelMatrix, glm::vec3(scale));
-	polynomialLine->modelMatrix = glm::rotate(polynomialLine->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
 
-	renderEngine->updateBuffers(*polynomialLine);
+	renderEngine->updateBuffers(*scene, polynomialLine);
 
 }
 
 void Program::updatePolynomialPoints(){
+	VertexArray& points = scene->verts(polynomialPoints);
 	if (parametersChanged) {
-		polynomialPoints->verts.clear();
+		points.clear();
 		pointCounter = 0;
 	}
 	// std::cout << mousePosition->x << "," << mousePosition->y << "," << mousePosition->z << std::endl;
 	//check that a click has been done
-	int width, height;
 	if(mousePosition->z==1 && pointCounter<3 && enablePoints){
-		glfwGetWindowSize(window, &width, &height);
-		glm::vec2 mousePosFix = glm::vec2(
-			((mousePosition->x - (float)width/2)/((float)width/2)) * 10 * (float)width / (float)height,
-			(((float)height/2 - mousePosition->y)/((float)height/2)) * 10
-		);
+		glm::vec2 mousePosFix = glm::vec2(renderEngine->screenToWorld(mousePosition->x, mousePosition->y) - scene->origin(polynomialPoints));
 		// std::cout << mousePosFix.x << "," << mousePosFix.y << std::endl;
 
 		// Add the point and a curve from that point
-		polynomialPoints->verts.push_back(glm::vec3(mousePosFix.x, mousePosFix.y, 0.f));
+		points.push_back(glm::vec3(mousePosFix.x, mousePosFix.y, 0.f));
 		// polynomialLine->verts.push_back(glm::vec3(mousePosFix.x, mousePosFix.y, 0.f));
 
 		// Reset the click counter
@@ -409,23 +1416,225 @@ void Program::updatePolynomialPoints(){
 
 	if (pointCounter > 2 && applyPolynomialScale) {
 		for (int i = 0; i < pointCounter; i++) {
-			polynomialPoints->verts[i] *= polynomialScale;
-			polynomialPoints->verts[i] += glm::vec3(offset[0], offset[1], 0.0f);
-			// std::cout << polynomialPoints->verts[i][0] << ", " << polynomialPoints->verts[i][1] << ", "<<i << std::endl;
+			points[i] *= polynomialScale;
+			points[i] += glm::vec3(offset[0], offset[1], 0.0f);
+			// std::cout << points[i][0] << ", " << points[i][1] << ", "<<i << std::endl;
 		}
 		polynomialScale = 1;
 		offset[0] = 0;
 		offset[1] = 0;
 		applyPolynomialScale = false;
+		dirty |= DIRTY_TRANSFORM;
+	}
+
+	renderEngine->updateBuffers(*scene, polynomialPoints);
+	dirty |= DIRTY_POLYNOMIAL_LINE;
+}
+float Program::galleryCellSize() const {
+	return 20.f / (float)glm::max(gallerySize[0], gallerySize[1]);
+}
+
+void Program::updateGallery() {
+	int columns = glm::max(gallerySize[0], 1);
+	int rows = glm::max(gallerySize[1], 1);
+	float cellSize = galleryCellSize();
+
+	// large radius varies along the columns, small radius along the rows
+	glm::vec4* curves = (glm::vec4*)sceneArena->scratch(sizeof(glm::vec4) * columns * rows, 16);
+	for (int row = 0; row < rows; row++) {
+		for (int column = 0; column < columns; column++) {
+			float u = columns > 1 ? (float)column / (float)(columns - 1) : 0.5f;
+			float v = rows > 1 ? (float)row / (float)(rows - 1) : 0.5f;
+			curves[row * columns + column] = glm::vec4(
+				glm::mix(galleryOuterRadii[0], galleryOuterRadii[1], u),
+				glm::mix(galleryInnerRadii[0], galleryInnerRadii[1], v),
+				((float)column - (float)(columns - 1) / 2) * cellSize,
+				((float)(rows - 1) / 2 - (float)row) * cellSize);
+		}
+	}
+	renderEngine->setGalleryCurves(curves, (size_t)columns * rows);
+}
+
+void Program::createEpicycles() {
+	epicyclePath = scene->create();
+	epicycleArms = scene->create();
+	epicycleCircles = scene->create();
+	renderEngine->assignBuffers(*scene, epicyclePath);
+	renderEngine->assignBuffers(*scene, epicycleArms);
+	renderEngine->assignBuffers(*scene, epicycleCircles);
+}
+
+void Program::takeEpicycleStroke() {
+	strokeInput.clear();
+	bool ended = InputHandler::takeStroke(strokeInput);
+	bool recording = sessionRecorder != nullptr && sessionRecorder->recording();
+	for (glm::vec2 position : strokeInput) {
+		if (recording) {
+			sessionRecorder->record(SessionEvent::STROKE, 0, &position, sizeof(position));
+		}
+		addEpicycleStrokePoint(position);
+	}
+	if (ended) {
+		if (recording) {
+			sessionRecorder->record(SessionEvent::STROKE, 1, nullptr, 0);
+		}
+		epicycleStrokeEnded = true;
+	}
+}
+
+void Program::addEpicycleStrokePoint(glm::vec2 window) {
+	glm::dvec2 world = renderEngine->screenToWorld(window.x, window.y);
+	if (epicycleStroke.empty()) {
+		epicycleStrokeOrigin = world;
+	}
+	epicycleStroke.push_back(glm::vec2(world - epicycleStrokeOrigin));
+	dirty |= DIRTY_EPICYCLES;
+}
+
+void Program::fitEpicycles() {
+	// a click without a drag leaves the last fit alone
+	if (epicycleStroke.size() > 1) {
+		epicycles.fit(epicycleStroke.data(), epicycleStroke.size(), Epicycles::DEFAULT_FIT_SAMPLES);
+		epicycleOrigin = epicycleStrokeOrigin;
+		epicycleTerms = glm::clamp(epicycleTerms, 1, (int)epicycles.size());
+		epicycleTime = 0.0;
+	}
+	epicycleStroke.clear();
+	epicycleStrokeEnded = false;
+	dirty |= DIRTY_EPICYCLES;
+}
+
+bool Program::epicyclesAnimating() const {
+	return epicycleMode && !pauseAnimation && amount > 0 && !epicycles.empty() && epicycleStroke.empty();
+}
+
+size_t Program::epicycleSampleCount() const {
+	// the fastest circle decides how finely the path has to be sampled, the others are all slower
+	size_t terms = glm::min((size_t)epicycleTerms, epicycles.size());
+	size_t fastest = 0;
+	for (size_t j = 0; j < terms; j++) {
+		fastest = glm::max(fastest, (size_t)std::abs(epicycles.frequency(j)));
+	}
+	return glm::max(fastest * EPICYCLE_SAMPLES_PER_TURN, EPICYCLE_MIN_SAMPLES) + 1;
+}
+
+void Program::updateEpicyclePath() {
+	PROFILE_ZONE("updateEpicyclePath");
+	VertexArray& verts = scene->verts(epicyclePath);
+	verts.clear();
+	scene->origin(epicyclePath) = epicycleStroke.empty() ? epicycleOrigin : epicycleStrokeOrigin;
+	if (epicycleMode && !epicycleStroke.empty()) {
+		for (glm::vec2 p : epicycleStroke) {
+			verts.push_back(glm::vec3(p, 0.f));
+		}
+	}
+	else if (epicycleMode && !epicycles.empty()) {
+		verts.resize(epicycleSampleCount());
+		epicycles.evaluate(*threadPool, epicycleTerms, verts.size(), verts.data());
 	}
+	renderEngine->updateBuffers(*scene, epicyclePath);
+}
 
-	// scale or rotate the polynomial
-	polynomialPoints->modelMatrix = glm::mat4(1.f);
-	polynomialPoints->modelMatrix = glm::scale(polynomialPoints->modelMatrix, glm::vec3(scale));
-	polynomialPoints->modelMatrix = glm::rotate(polynomialPoints->modelMatrix, glm::radians(rotation), glm::vec3(0, 0, 1.0f));
+void Program::updateEpicycleChain() {
+	VertexArray& arms = scene->verts(epicycleArms);
+	VertexArray& circles = scene->verts(epicycleCircles);
+	arms.clear();
+	circles.clear();
+	epicycleCircleFirsts.clear();
+	epicycleCircleCounts.clear();
+
+	// hidden while a new path is being drawn
+	if (epicycleMode && !epicycles.empty() && epicycleStroke.empty()) {
+		if (epicyclesAnimating()) {
+			epicycleTime = std::fmod(epicycleTime + TWO_PI * amount / EPICYCLE_FRAMES_PER_TURN, TWO_PI);
+		}
+		size_t terms = glm::min((size_t)epicycleTerms, epicycles.size());
+		arms.resize(terms + 1);
+		epicycles.chain(terms, epicycleTime, arms.data());
+
+		// each circle is centered where the arms before it end
+		size_t shown = glm::min(terms, EPICYCLE_CIRCLES);
+		size_t perCircle = CurveGenerator::circleSampleCount(EPICYCLE_CIRCLE_DETAIL);
+		circles.resize(shown * perCircle);
+		for (size_t j = 0; j < shown; j++) {
+			CurveGenerator::circle(arms[j], epicycles.radius(j), EPICYCLE_CIRCLE_DETAIL, 0, perCircle, circles.data() + j * perCircle);
+			epicycleCircleFirsts.push_back((GLint)(j * perCircle));
+			epicycleCircleCounts.push_back((GLsizei)perCircle);
+		}
+	}
+	scene->origin(epicycleArms) = epicycleOrigin;
+	scene->origin(epicycleCircles) = epicycleOrigin;
+	renderEngine->updateBuffers(*scene, epicycleArms);
+	renderEngine->updateBuffers(*scene, epicycleCircles);
+	scene->setDrawRanges(epicycleCircles, epicycleCircleFirsts.data(), epicycleCircleCounts.data(), epicycleCircleFirsts.size());
+}
 
-	renderEngine->updateBuffers(*polynomialPoints);
+void Program::createCustomCurve() {
+	customCurve = scene->create();
+	renderEngine->assignBuffers(*scene, customCurve);
+	compileCustomCurve();
+	// the default expressions are the hypocycloid, with parameters R and r
+	customValues = { outerRadius, innerRadius };
 }
+
+void Program::compileCustomCurve() {
+	std::vector<std::string> oldNames = customExpression.parameterNames();
+	if (!customExpression.compile(customX, customY)) {
+		return;
+	}
+	std::vector<float> values;
+	for (const std::string& name : customExpression.parameterNames()) {
+		size_t old = std::find(oldNames.begin(), oldNames.end(), name) - oldNames.begin();
+		values.push_back(old < oldNames.size() ? customValues[old] : 1.f);
+	}
+	customValues.swap(values);
+	dirty |= DIRTY_CUSTOM_CURVE;
+}
+
+void Program::customTextChanged() {
+	if (sessionRecorder != nullptr && sessionRecorder->recording()) {
+		// events hold 16 bytes, the text goes in as many as it takes
+		const char* texts[2] = { customX, customY };
+		for (uint8_t id = 0; id < 2; id++) {
+			size_t length = strlen(texts[id]);
+			for (size_t piece = 0; piece < length; piece += sizeof(SessionEvent::data)) {
+				sessionRecorder->record(SessionEvent::EXPRESSION, id, texts[id] + piece, glm::min(length - piece, sizeof(SessionEvent::data)));
+			}
+		}
+		sessionRecorder->record(SessionEvent::EXPRESSION, 2, nullptr, 0);
+	}
+	compileCustomCurve();
+}
+
+void Program::customValueChanged(size_t index) {
+	if (sessionRecorder != nullptr && sessionRecorder->recording()) {
+		uint8_t data[8];
+		int32_t parameter = (int32_t)index;
+		memcpy(data, &parameter, 4);
+		memcpy(data + 4, &customValues[index], 4);
+		sessionRecorder->record(SessionEvent::EXPRESSION, 3, data, sizeof(data));
+	}
+	dirty |= DIRTY_CUSTOM_CURVE;
+}
+
+void Program::updateCustomCurve() {
+	PROFILE_ZONE("updateCustomCurve");
+	VertexArray& verts = scene->verts(customCurve);
+	verts.clear();
+	if (viewCustomCurve && !customExpression.empty()) {
+		size_t count = (size_t)customSamples;
+		double dt = ((double)customRange[1] - customRange[0]) / (double)(count - 1);
+		// no evaluation or upload on the CPU at all, unless the driver can't build the shader
+		if (computeGeneration()
+			&& renderEngine->computeExpression(*scene, customCurve, customExpression, customValues.data(), customRange[0], dt, count)) {
+			return;
+		}
+		verts.resize(count);
+		customExpression.evaluate(*threadPool, customValues.data(), customRange[0], dt, count, verts.data());
+	}
+	renderEngine->updateBuffers(*scene, customCurve);
+}
+
 // Main loop
 void Program::mainLoop() {
 	// createTestGeometryObject();
@@ -436,38 +1645,156 @@ void Program::mainLoop() {
 	createLastPoint();
 
 	createPolynomial();
+	createEpicycles();
+	createCustomCurve();
 
 	// Our state
 	show_test_window = false;
 	clear_color = ImVec4(0.0f, 0.0f, 0.0f, 1.00f);
 	lineColor = ImVec4(1.0f, 1.0f, 0.0f, 1.00f);
 
+	int windowWidth, windowHeight;
+	glfwGetWindowSize(window, &windowWidth, &windowHeight);
+	PROFILE_THREAD("main");
+
+	// frames in a row in which nothing happened
+	int idleFrames = 0;
+
 	while(!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+		// once a few frames went by without anything to do, sleep until there is input or a curve arrives
+		bool replaying = sessionRecorder != nullptr && sessionRecorder->replaying();
+		// only recorded strokes count during a replay
+		InputHandler::captureStrokes(epicycleMode && !replaying);
+		if (idleFrames >= IDLE_FRAMES && !replaying) {
+			glfwWaitEventsTimeout(IDLE_TIMEOUT);
+		}
+		else {
+			glfwPollEvents();
+		}
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		sceneArena->resetScratch();
+
+		if (sessionRecorder != nullptr) {
+			sessionRecorder->beginFrame();
+			if (sessionRecorder->replaying()) {
+				// live clicks would change the outcome, only recorded ones count
+				mousePosition->z = 0;
+				applySessionEvents();
+			}
+			else if (sessionRecorder->recording()) {
+				if (mousePosition->z == 1) {
+					float position[2] = { mousePosition->x, mousePosition->y };
+					sessionRecorder->record(SessionEvent::CLICK, 0, position, sizeof(position));
+				}
+				int width, height;
+				glfwGetWindowSize(window, &width, &height);
+				if (width != windowWidth || height != windowHeight) {
+					int32_t size[2] = { width, height };
+					sessionRecorder->record(SessionEvent::RESIZE, 0, size, sizeof(size));
+					windowWidth = width;
+					windowHeight = height;
+				}
+			}
+		}
 
+		if (!replaying) {
+			takeEpicycleStroke();
+		}
+		takeCameraMoves(replaying);
+
+		CurveResult* result = curveWorker->takeResult();
+		bool active = InputHandler::takeActivity() || result != nullptr || dirty != DIRTY_NONE || isAnimating() || epicyclesAnimating()
+			|| replaying;
+		receiveCycloid(result);
+		storeCycloid();
+		if (active) {
+			idleFrames = 0;
+		}
+		else if (idleFrames >= IDLE_FRAMES) {
+			// the last frame is still on screen
+			continue;
+		}
+		else {
+			// ImGui needs a couple of frames to settle hover and focus after the last input
+			idleFrames++;
+		}
+
+		// Only regenerate the geometry whose inputs changed since the last frame
 		if(viewHypocycloid) {
-			updateCycloid();
-			updateInnerCircle();
-			updateOuterCircle();
-			updateLastPoint();
+			// density mode also has to notice the view moving, which only shows up as a different mapping
+			if ((dirty & DIRTY_CYCLOID) || isAnimating() || densityMode) {
+				updateCycloid();
+			}
+			if (dirty & DIRTY_INNER_CIRCLE) {
+				updateInnerCircle();
+			}
+			if (dirty & DIRTY_OUTER_CIRCLE) {
+				updateOuterCircle();
+			}
+			if (dirty & DIRTY_LAST_POINT) {
+				updateLastPoint();
+			}
 			mousePosition->z = 0;
 		}
 		else {
-			lastPoint->verts.clear();
-			outerCircle->verts.clear();
-			innerCircle->verts.clear();
-			hypocycloid->verts.clear();
-
-			theta = 0;
-			thetaCi = 0;
-			thetaCo = 0;
-
-			updatePolynomialPoints();
-			updatePolynomialLines();
+			if (dirty & (DIRTY_CYCLOID | DIRTY_INNER_CIRCLE | DIRTY_OUTER_CIRCLE | DIRTY_LAST_POINT)) {
+				scene->verts(outerCircle).clear();
+				scene->verts(innerCircle).clear();
+				scene->verts(hypocycloid).clear();
+				scene->verts(cycloidDetail).clear();
+				drawnCycloid.reset();
+				cycloidBVH.clear();
+				computedCycloidSamples = 0;
+				renderEngine->updateBuffers(*scene, cycloidDetail);
+				renderEngine->updateBuffers(*scene, outerCircle);
+				renderEngine->updateBuffers(*scene, innerCircle);
+				renderEngine->updateBuffers(*scene, hypocycloid);
+
+				cycloidRevealed = 0;
+				theta = 0;
+				updateLastPoint();
+				curveWorker->cancel();
+				cycloidPending = false;
+				cycloidStoreDue = false;
+			}
+
+			bool clicked = mousePosition->z == 1 && pointCounter < 3 && enablePoints;
+			if (parametersChanged || applyPolynomialScale || clicked || (dirty & DIRTY_POLYNOMIAL_POINTS)) {
+				updatePolynomialPoints();
+			}
+			if (dirty & DIRTY_POLYNOMIAL_LINE) {
+				updatePolynomialLines();
+			}
+		}
+		if (dirty & DIRTY_TRANSFORM) {
+			updateTransforms();
+		}
+		if (renderEngine->cameraVersion() != detailCameraVersion) {
+			detailCameraVersion = renderEngine->cameraVersion();
+			dirty |= DIRTY_DETAIL;
+		}
+		if (viewHypocycloid && (dirty & DIRTY_DETAIL)) {
+			updateCycloidDetail();
+		}
+		if (viewGallery && (dirty & DIRTY_GALLERY)) {
+			updateGallery();
+		}
+		if (epicycleStrokeEnded) {
+			fitEpicycles();
+		}
+		if (dirty & DIRTY_EPICYCLES) {
+			updateEpicyclePath();
+		}
+		if ((dirty & DIRTY_EPICYCLES) || epicyclesAnimating()) {
+			updateEpicycleChain();
+		}
+		if (dirty & DIRTY_CUSTOM_CURVE) {
+			updateCustomCurve();
 		}
 		if (parametersChanged) {
 			parametersChanged = false;
 		}
+		dirty = DIRTY_NONE;
 
 		drawUI();
 
@@ -479,17 +1806,62 @@ void Program::mainLoop() {
 		glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		renderEngine->render(geometryObjects, glm::mat4(1.f), glm::vec4(lineColor.x,lineColor.y,lineColor.z,lineColor.w));
+		glm::vec4 color = glm::vec4(lineColor.x, lineColor.y, lineColor.z, lineColor.w);
+		if (viewGallery) {
+			glm::mat4 galleryView = glm::translate(glm::mat4(1.f), glm::vec3(offset[0], offset[1], 0.0f));
+			galleryView = glm::scale(galleryView, glm::vec3(scale));
+			renderEngine->renderGallery(gallerySamples, PI * 2 * cycles, galleryCellSize(), glm::radians(rotation), galleryView, color);
+		}
+		else {
+			renderEngine->render(*scene, glm::mat4(1.f), color);
+			if (densityMode && viewHypocycloid) {
+				renderEngine->renderDensity(color);
+			}
+			else if (trailMode && viewHypocycloid) {
+				renderEngine->renderTrail(scene->modelMatrix(hypocycloid), color, !hideDot);
+			}
+		}
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-		glfwSwapBuffers(window);
+		{
+			PROFILE_ZONE("swapBuffers");
+			glfwSwapBuffers(window);
+		}
+
+		if (sessionRecorder != nullptr && sessionRecorder->replaying()) {
+			glFinish();
+			// timed before hashing, which walks every vertex and isn't part of the frame
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+			sessionRecorder->endFrame(seconds, geometryHash());
+			if (sessionRecorder->finished()) {
+				break;
+			}
+		}
+	}
+
+	if (sessionRecorder != nullptr) {
+		sessionRecorder->finish(sessionReportPath);
+		delete sessionRecorder;
+		sessionRecorder = nullptr;
 	}
 
+	PROFILE_DUMP("hypo_trace.json");
+
 	// Clean up, program needs to exit
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
+	// the worker's buffers come from the arena, so it has to go first
+	delete curveWorker;
+	cachedCycloid.reset();
+	drawnCycloid.reset();
+	delete curveCache;
+	delete threadPool;
+	renderEngine->releaseScene(*scene);
+	delete scene;
+	delete sceneArena;
+
 	glfwDestroyWindow(window);
 	delete renderEngine;
 	glfwTerminate();
@@ -7,38 +7,242 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <vector>
 
-#include "Geometry.h"
+#include "CurveCache.h"
+#include "CurveExpression.h"
+#include "CurveGenerator.h"
+#include "CurveWorker.h"
+#include "DensityMap.h"
+#include "Epicycles.h"
 #include "InputHandler.h"
 #include "RenderEngine.h"
+#include "Scene.h"
+#include "SceneArena.h"
+#include "SegmentBVH.h"
+#include "SessionRecorder.h"
+#include "ThreadPool.h"
+#include "VectorExporter.h"
 
 class Program {
 
 public:
 	Program();
 	void start();
+	// start() while logging every input and parameter edit to path
+	void record(const char* path);
+	// start() playing back a recorded log, then write a frame time report and exit
+	void replay(const char* path, const char* reportPath);
+	// runs UploadBenchmark in a window instead of the interactive program
+	void benchmarkUploads(const char* reportPath);
 
 private:
 	GLFWwindow* window;
 	RenderEngine* renderEngine;
+	SceneArena* sceneArena;
+	ThreadPool* threadPool;
+	CurveWorker* curveWorker;
+	CurveCache* curveCache;
+	SessionRecorder* sessionRecorder;
+	const char* sessionPath;
+	const char* sessionReportPath;
 
-	std::vector<Geometry*> geometryObjects;
+	Scene* scene;
 
 	bool show_test_window;
 	ImVec4 clear_color;
 
+	// Derived geometry that a parameter change can invalidate
+	enum DirtyFlags : unsigned int {
+		DIRTY_NONE = 0,
+		DIRTY_CYCLOID = 1 << 0,
+		DIRTY_INNER_CIRCLE = 1 << 1,
+		DIRTY_OUTER_CIRCLE = 1 << 2,
+		DIRTY_LAST_POINT = 1 << 3,
+		DIRTY_POLYNOMIAL_POINTS = 1 << 4,
+		DIRTY_POLYNOMIAL_LINE = 1 << 5,
+		DIRTY_TRANSFORM = 1 << 6,
+		DIRTY_GALLERY = 1 << 7,
+		DIRTY_DETAIL = 1 << 8,
+		DIRTY_EPICYCLES = 1 << 9,
+		DIRTY_CUSTOM_CURVE = 1 << 10,
+		DIRTY_ALL = (1 << 11) - 1
+	};
+
+	// Every parameter that can be edited from the UI
+	enum ParamId {
+		PARAM_INNER_RADIUS,
+		PARAM_OUTER_RADIUS,
+		PARAM_CYCLES,
+		PARAM_ROTATION,
+		PARAM_SCALE,
+		PARAM_STEP,
+		PARAM_AMOUNT,
+		PARAM_CIRCLE_DETAIL,
+		PARAM_HIDE_INNER_CIRCLE,
+		PARAM_HIDE_OUTER_CIRCLE,
+		PARAM_HIDE_DOT,
+		PARAM_PAUSE_ANIMATION,
+		PARAM_VIEW_HYPOCYCLOID,
+		PARAM_ENABLE_POINTS,
+		PARAM_POLYNOMIAL_SCALE,
+		PARAM_OFFSET,
+		PARAM_VIEW_GALLERY,
+		PARAM_GALLERY_OUTER_RADII,
+		PARAM_GALLERY_INNER_RADII,
+		PARAM_GALLERY_SIZE,
+		PARAM_GALLERY_SAMPLES,
+		PARAM_GENERATE_ON_GPU,
+		PARAM_TRAIL_MODE,
+		PARAM_TRAIL_LENGTH,
+		PARAM_INSTANCE_ARCS,
+		PARAM_DENSITY_MODE,
+		PARAM_DENSITY_EXPOSURE,
+		PARAM_EPICYCLE_MODE,
+		PARAM_EPICYCLE_TERMS,
+		PARAM_CUSTOM_CURVE,
+		PARAM_CUSTOM_RANGE,
+		PARAM_CUSTOM_SAMPLES,
+		PARAM_COUNT
+	};
+
+	// The geometry each parameter invalidates, indexed by ParamId
+	static const unsigned int paramInvalidates[PARAM_COUNT];
+
+	// UI buttons that change state without going through a parameter
+	enum SessionAction {
+		ACTION_REFRESH,
+		ACTION_RESET,
+		ACTION_APPLY_POLYNOMIAL_SCALE
+	};
+
+	// Ways the view moves, with the floats each takes: pan by x, y pixels, zoom about x, y by a factor, reset
+	enum CameraChange {
+		CAMERA_PAN,
+		CAMERA_ZOOM,
+		CAMERA_RESET
+	};
+
+	// frames drawn after the last activity before the loop starts waiting for events
+	static const int IDLE_FRAMES = 3;
+	// seconds to wait for events when idle, as a safety net for anything that doesn't post one
+	static constexpr double IDLE_TIMEOUT = 0.5;
+	// seconds a curve has to stay up before it is cached, so dragging a slider doesn't write every step;
+	// curves this many samples long are cached right away, they are the ones worth not generating again
+	static constexpr double STORE_DELAY = 2.0;
+	static const size_t STORE_AT_ONCE_SAMPLES = 1 << 22;
+
+	// detail curve spacing in pixels, how many samples it may take and how finely its visible stretches are found
+	static constexpr float DETAIL_PIXELS = 2.f;
+	static const size_t MAX_DETAIL_SAMPLES = 1 << 21;
+	static const size_t DETAIL_GRAIN = 256;
+	// largest sample index a double holds exactly
+	static constexpr double MAX_EXACT_INDEX = 9007199254740992.0;
+	// how close in pixels the cursor has to be to the curve to show where it is on it
+	static constexpr float HOVER_PIXELS = 8.f;
+	// shortest arc, in segments, worth drawing as an instance instead of generating every copy
+	static const size_t MIN_ARC_SEGMENTS = 64;
+	// longest a curve may take to close for its symmetry to be shown
+	static const int MAX_SYMMETRY_CYCLES = 1000;
+	// samples binned into the density map per frame
+	static const size_t DENSITY_SAMPLES_PER_FRAME = 1 << 22;
+	// samples per turn of the fastest circle in use when drawing the path the chain traces, and the fewest overall
+	static const size_t EPICYCLE_SAMPLES_PER_TURN = 4;
+	static const size_t EPICYCLE_MIN_SAMPLES = 256;
+	// frames the chain takes to go once around its path at animation speed 1
+	static const int EPICYCLE_FRAMES_PER_TURN = 600;
+	// only the largest circles of the chain are drawn, the rest are too small to make out
+	static const size_t EPICYCLE_CIRCLES = 64;
+	static const int EPICYCLE_CIRCLE_DETAIL = 10;
+
 	static void error(int error, const char* description);
 	void setupWindow();
 	void mainLoop();
 	void drawUI();
+	// tooltip with the curve point under the cursor
+	void hoverCycloid();
 
 	void createTestGeometryObject();
 
+	// mark whatever depends on a parameter for regeneration
+	void paramChanged(ParamId param);
+	// where a parameter lives and how many bytes it takes, for recording and replaying it
+	void* paramStorage(ParamId param, size_t& size);
+	void performAction(SessionAction action);
+	void changeCamera(CameraChange change, const float* values);
+	// applies this frame's pans and zooms from InputHandler and a view reset from the UI, or drops them during a replay
+	void takeCameraMoves(bool replaying);
+	// feeds this frame's recorded events back in during a replay
+	void applySessionEvents();
+	// checksum of all scene vertices and the ranges and copies drawn of them, to check that replays produce the same
+	// geometry; only buffers written since the last call are hashed again
+	uint64_t geometryHash();
+	// rebuild the model matrices from rotation, scale and offset
+	void updateTransforms();
+	bool isAnimating() const;
+	// whether curves are evaluated by RenderEngine's compute shader instead of CurveGenerator
+	bool computeGeneration() const;
+
 	// draw the cycloid 
 	void createCycloid();
 	void updateCycloid();
+	// trail mode: extends the ring buffer trail instead of revealing a precomputed curve
+	void updateTrail();
+	// density mode: bins the next samples into the density map instead of drawing lines
+	void updateDensity();
+	// drops the line strip and everything derived from it, for the modes that don't draw one
+	void clearCycloid();
+	// swaps in a curve finished by the worker, if there is one
+	void receiveCycloid(CurveResult* result);
+	CurveParams cycloidParams() const;
+	size_t cycloidSampleCount() const;
+	// draws the first cycloidRevealed samples and moves the dot and inner circle to the last of them
+	void revealCycloid();
+	// re-tessellates the part of the curve inside the view finer when zoomed in past the base resolution
+	void updateCycloidDetail();
+	// how many pieces each base segment needs to look smooth at the current zoom
+	size_t cycloidSubdivisions() const;
+	// the model matrix in double, followed by a shift that puts anchor at the origin
+	glm::dmat3 cycloidTransform(glm::dvec2 anchor) const;
+	// sample spacing of the uploaded curve, which for an arc is a little off params.step so copies meet exactly
+	double cycloidSamplesPerRadian() const;
+	// Whether the current parameters get generated as one arc drawn as rotated copies, and that arc's angle and
+	// segment count if so
+	bool cycloidArcSplit(double& angle, size_t& segments) const;
+	// which copy of the uploaded arc and which of its vertices show sample index `sample` of the whole curve
+	void arcPosition(size_t sample, size_t& copy, size_t& vertex) const;
+	// sets the curve's draw range, or its copies, to the first cycloidRevealed samples
+	void showRevealed();
+	// Has the worker save the curve once it is complete, longer than what the cache already has, and either
+	// large or still current after STORE_DELAY. Called every frame.
+	void storeCycloid();
+
+	// epicycle mode: a chain of circles fitted to a path drawn with the mouse
+	void createEpicycles();
+	// collects this frame's stroke positions from InputHandler, recording them if a session is
+	void takeEpicycleStroke();
+	void addEpicycleStrokePoint(glm::vec2 window);
+	// fits the chain to the finished stroke
+	void fitEpicycles();
+	// the path the first epicycleTerms terms trace, or the stroke while it is still being drawn
+	void updateEpicyclePath();
+	// the chain's arms and largest circles at epicycleTime
+	void updateEpicycleChain();
+	bool epicyclesAnimating() const;
+	size_t epicycleSampleCount() const;
+
+	// custom curve: x(t) and y(t) typed into the UI
+	void createCustomCurve();
+	// recompiles the expressions, keeping the values of parameters that are still there
+	void compileCustomCurve();
+	// the same for an edit in the UI, recording the text if a session is
+	void customTextChanged();
+	void customValueChanged(size_t index);
+	void updateCustomCurve();
 
 	// draw the circles
 	void createInnerCircle();
@@ -54,8 +258,17 @@ private:
 	void createPolynomial();
 	void updatePolynomialPoints();
 	void updatePolynomialLines();
+
+	// lay out the parameter sweep gallery and upload its instances
+	void updateGallery();
+	float galleryCellSize() const;
+
+	// write every visible line in the scene to hypocycloid.svg or hypocycloid.pdf
+	void exportScene(VectorExporter::Format format);
 	// PI constant since I'm too lazy to use a library when I can just copy paste
 	float PI = 3.14159265358979323846264338327950288;
+	// the same in double, for wrapping the angles of far copies of an arc
+	static constexpr double TWO_PI = 6.28318530717958647692;
 	
 	// Class variables for controlling the hypocycloid.
 	float outerRadius = 4;
@@ -76,18 +289,46 @@ private:
 	bool viewHypocycloid = true;
 
 	float theta = 0;
-	float thetaCi = 0;
-	float thetaCo = 0;
+	// samples of the precomputed curve the animation has drawn so far
+	size_t cycloidRevealed = 0;
+	// samples the compute shader last wrote into the curve's buffer, until the CPU replaces them
+	size_t computedCycloidSamples = 0;
+	// RenderEngine::cameraVersion the detail curve was made for
+	unsigned int detailCameraVersion = 0;
+	// visible runs of the detail curve, reused between frames
+	std::vector<GLint> detailFirsts;
+	std::vector<GLsizei> detailCounts;
+	// the same runs as fine sample indices, which outgrow GLint at deep zoom
+	std::vector<size_t> detailSampleFirsts;
+	std::vector<size_t> detailSampleCounts;
+	// segment bounds of the full curve, for culling and picking
+	SegmentBVH cycloidBVH;
+	// UI panel position and size in pixels as of the last frame, curve under it isn't drawn
+	glm::vec4 uiPanel = glm::vec4(0.f);
+
+	// generation of the curve requested from the worker, and whether we're still waiting on it
+	unsigned int cycloidGeneration = 0;
+	bool cycloidPending = false;
+	// whether the generated curve up now should go to the cache, and since when it is up
+	bool cycloidStoreDue = false;
+	std::chrono::steady_clock::time_point cycloidCurrentSince;
+	// cache file for the current curve parameters, if there is one
+	std::shared_ptr<const MappedCurve> cachedCycloid;
+	// the cache file the hypocycloid's vertices are borrowed from, kept mapped while they are drawn
+	std::shared_ptr<const MappedCurve> drawnCycloid;
 
 	bool parametersChanged = true;
+	// DirtyFlags of geometry that must be regenerated this frame
+	unsigned int dirty = DIRTY_ALL;
 
 	// Class variable for the hypocycloid
-	Geometry* hypocycloid;
-	Geometry* innerCircle;
-	Geometry* outerCircle;
-	Geometry* lastPoint;
-	Geometry* polynomialPoints;
-	Geometry* polynomialLine;
+	GeometryHandle hypocycloid;
+	GeometryHandle cycloidDetail;
+	GeometryHandle innerCircle;
+	GeometryHandle outerCircle;
+	GeometryHandle lastPoint;
+	GeometryHandle polynomialPoints;
+	GeometryHandle polynomialLine;
 
 	glm::vec3 *mousePosition;
 
@@ -96,5 +337,79 @@ private:
 
 	float offset[2] = { 0, 0 };
 
+	// Parameter sweep gallery: a grid of curves over ranges of both radii, drawn with one instanced draw
+	bool viewGallery = false;
+	// evaluate curves on the GPU straight into their vertex buffers, nothing is kept on the CPU
+	bool generateOnGpu = false;
+	// animate forever, keeping only the last trailLength samples, instead of precomputing cycles turns
+	bool trailMode = false;
+	int trailLength = 20000;
+	// index of the next sample the trail gets
+	size_t trailIndex = 0;
+	// this frame's new trail samples
+	std::vector<glm::vec3> trailSamples;
+	// generate one of the congruent arcs a curve is made of and draw the rest as rotated instances of it
+	bool instanceArcs = true;
+	// angle between copies and segments per copy of the uploaded arc, 0 if the buffer holds the whole curve
+	double cycloidArc = 0.0;
+	size_t cycloidArcSegments = 0;
+	// the same for the curve the worker is generating
+	double requestedArc = 0.0;
+	size_t requestedArcSegments = 0;
+	// one copy's visible runs, before they are shifted to where the copy sits along the curve
+	std::vector<GLint> arcFirsts;
+	std::vector<GLsizei> arcCounts;
+	// shade the window by how often the curve passes through each pixel, for curves too long to draw as lines
+	bool densityMode = false;
+	float densityExposure = DensityMap::DEFAULT_EXPOSURE;
+	DensityMap densityMap;
+	std::vector<uint8_t> densityImage;
+	// curve to pixel mapping the map was binned with, samples binned so far, and the exposure last shown
+	glm::dmat3 densityToPixels = glm::dmat3(0.0);
+	size_t densitySamples = 0;
+	float densityShownExposure = -1.f;
+	// fit a chain of rotating circles to a path drawn with the left button and animate it tracing the path
+	bool epicycleMode = false;
+	// how many of the chain's circles are used, largest first
+	int epicycleTerms = 100;
+	Epicycles epicycles;
+	// the stroke being drawn, relative to where it started, and whether it has ended and is waiting to be fitted;
+	// the fit is relative to where its stroke started
+	std::vector<glm::vec2> epicycleStroke;
+	glm::dvec2 epicycleStrokeOrigin = glm::dvec2(0.0);
+	glm::dvec2 epicycleOrigin = glm::dvec2(0.0);
+	bool epicycleStrokeEnded = false;
+	// this frame's stroke positions in window coordinates
+	std::vector<glm::vec2> strokeInput;
+	// vertices read back from the GPU to hash them
+	std::vector<glm::vec3> hashInput;
+	// this frame's pans and zooms
+	std::vector<InputHandler::CameraMove> cameraInput;
+	bool viewResetRequested = false;
+	// where the chain is along its path, in [0, 2 pi)
+	double epicycleTime = 0.0;
+	GeometryHandle epicyclePath;
+	GeometryHandle epicycleArms;
+	// one draw range per circle
+	GeometryHandle epicycleCircles;
+	std::vector<GLint> epicycleCircleFirsts;
+	std::vector<GLsizei> epicycleCircleCounts;
+	// draw a curve given as expressions in t, over customRange in customSamples samples
+	bool viewCustomCurve = false;
+	char customX[256] = "(R - r) * cos(t) + r * cos((R - r) / r / r * t)";
+	char customY[256] = "(R - r) * sin(t) - r * sin((R - r) / r / r * t)";
+	float customRange[2] = { 0.f, 6.2831853f };
+	int customSamples = 10000;
+	CurveExpression customExpression;
+	// slider values of the expressions' parameters, indexed like CurveExpression::parameterNames
+	std::vector<float> customValues;
+	// text arriving in pieces during a replay, until the whole of it is there
+	std::string replayedCustomText[2];
+	GeometryHandle customCurve;
+	float galleryOuterRadii[2] = { 2, 8 };
+	float galleryInnerRadii[2] = { 0.5f, 3 };
+	int gallerySize[2] = { 64, 64 };
+	int gallerySamples = 2048;
+
 	ImVec4 lineColor;
 };
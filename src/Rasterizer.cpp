@@ -0,0 +1,78 @@
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+Rasterizer::Rasterizer(int width, int height) : imageWidth(width), imageHeight(height), image((size_t)width * height, 0) {
+}
+
+void Rasterizer::clear() {
+	std::fill(image.begin(), image.end(), 0);
+}
+
+// Adds coverage to a pixel, saturating so overlapping strokes get brighter but never wrap
+void Rasterizer::plot(int x, int y, float coverage) {
+	if (x < 0 || y < 0 || x >= imageWidth || y >= imageHeight) {
+		return;
+	}
+	uint8_t& pixel = image[(size_t)y * imageWidth + x];
+	int value = pixel + (int)(coverage * 255.f + 0.5f);
+	pixel = (uint8_t)(value > 255 ? 255 : value);
+}
+
+// Xiaolin Wu's antialiased line
+void Rasterizer::drawLine(glm::vec2 a, glm::vec2 b) {
+	bool steep = std::fabs(b.y - a.y) > std::fabs(b.x - a.x);
+	if (steep) {
+		std::swap(a.x, a.y);
+		std::swap(b.x, b.y);
+	}
+	if (a.x > b.x) {
+		std::swap(a, b);
+	}
+
+	float dx = b.x - a.x;
+	float gradient = dx == 0 ? 1.f : (b.y - a.y) / dx;
+
+	// skip segments that are entirely outside the image along the major axis
+	float major = (float)(steep ? imageHeight : imageWidth);
+	if (b.x < -1 || a.x > major + 1) {
+		return;
+	}
+	float startX = std::floor(std::fmax(a.x, -1.f) + 0.5f);
+	float endX = std::floor(std::fmin(b.x, major + 1) + 0.5f);
+	float y = a.y + gradient * (startX - a.x);
+
+	// half open in x so the shared endpoint of consecutive segments in a strip is only drawn once
+	for (float x = startX; x < endX; x++) {
+		float fy = std::floor(y);
+		float frac = y - fy;
+		if (steep) {
+			plot((int)fy, (int)x, 1 - frac);
+			plot((int)fy + 1, (int)x, frac);
+		}
+		else {
+			plot((int)x, (int)fy, 1 - frac);
+			plot((int)x, (int)fy + 1, frac);
+		}
+		y += gradient;
+	}
+}
+
+bool Rasterizer::writePGM(const char* path) const {
+	return writePGM(path, imageWidth, imageHeight, image.data());
+}
+
+bool Rasterizer::writePGM(const char* path, int width, int height, const uint8_t* pixels) {
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	fprintf(file, "P5\n%d %d\n255\n", width, height);
+	size_t size = (size_t)width * height;
+	size_t written = fwrite(pixels, 1, size, file);
+	fclose(file);
+	return written == size;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Minimal CPU rasterizer for curves: antialiased lines into an 8-bit grayscale image.
+// Each instance owns its image, so every thread of the batch renderer can draw with its own.
+class Rasterizer {
+
+public:
+	Rasterizer(int width, int height);
+
+	void clear();
+	// a and b are in pixel coordinates, y pointing down
+	void drawLine(glm::vec2 a, glm::vec2 b);
+	// binary PGM (P5)
+	bool writePGM(const char* path) const;
+	static bool writePGM(const char* path, int width, int height, const uint8_t* pixels);
+
+	int width() const { return imageWidth; }
+	int height() const { return imageHeight; }
+	const uint8_t* pixels() const { return image.data(); }
+
+private:
+	void plot(int x, int y, float coverage);
+
+	int imageWidth;
+	int imageHeight;
+	std::vector<uint8_t> image;
+};
@@ -1,12 +1,88 @@
 #include "RenderEngine.h"
 
-RenderEngine::RenderEngine(GLFWwindow* window) : window(window) {
-	int width, height;
-	glfwGetWindowSize(window, &width, &height);
-	float aspectRatio = ((float)width / (float)height);
-	ortho = glm::ortho(-10.0f * aspectRatio, 10.0f * aspectRatio, -10.0f, 10.0f, -1.0f, 1.0f);
+#include <cmath>
+#include <cstring>
+
+#include "Profiler.h"
+
+RenderEngine::RenderEngine(GLFWwindow* window) : window(window), uploadStrategy(UPLOAD_BUFFER_DATA), computeProgram(0), computeWrites(false), trailCapacity(0), trailHead(0), trailFilled(0), densityWidth(0), densityHeight(0), cameraCenter(0.0), cameraZoom(1.0), cameraChanges(0) {
+	glfwGetWindowSize(window, &windowWidth, &windowHeight);
+	updateProjection();
 
 	mainProgram = ShaderTools::compileShaders("shaders/main.vert", "shaders/main.frag");
+	modelViewLocation = glGetUniformLocation(mainProgram, "modelView");
+	orthoLocation = glGetUniformLocation(mainProgram, "ortho");
+	colorLocation = glGetUniformLocation(mainProgram, "color");
+	// the angle of each rotated copy, refilled every frame for all of them and pulled one per instance
+	glGenBuffers(1, &copyAngleBuffer);
+
+	galleryProgram = ShaderTools::compileShaders("shaders/gallery.vert", "shaders/main.frag");
+	galleryModelViewLocation = glGetUniformLocation(galleryProgram, "modelView");
+	galleryOrthoLocation = glGetUniformLocation(galleryProgram, "ortho");
+	galleryColorLocation = glGetUniformLocation(galleryProgram, "color");
+	gallerySamplesLocation = glGetUniformLocation(galleryProgram, "samples");
+	galleryThetaMaxLocation = glGetUniformLocation(galleryProgram, "thetaMax");
+	galleryCellSizeLocation = glGetUniformLocation(galleryProgram, "cellSize");
+	galleryRotationLocation = glGetUniformLocation(galleryProgram, "rotation");
+
+	// curve generation on the GPU is optional, everything falls back to CurveGenerator without it
+	if (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object) {
+		computeProgram = ShaderTools::compileComputeShader("shaders/curve.comp");
+	}
+	if (computeProgram != 0) {
+		computeCurveLocation = glGetUniformLocation(computeProgram, "curve");
+		computeFirstLocation = glGetUniformLocation(computeProgram, "first");
+		computeCountLocation = glGetUniformLocation(computeProgram, "count");
+		computeOuterRadiusLocation = glGetUniformLocation(computeProgram, "outerRadius");
+		computeInnerRadiusLocation = glGetUniformLocation(computeProgram, "innerRadius");
+		computeStepLocation = glGetUniformLocation(computeProgram, "samplesPerRadian");
+		computeCenterLocation = glGetUniformLocation(computeProgram, "center");
+		computeRadiusLocation = glGetUniformLocation(computeProgram, "radius");
+		computeDetailLocation = glGetUniformLocation(computeProgram, "detail");
+		computeALocation = glGetUniformLocation(computeProgram, "a");
+		computeBLocation = glGetUniformLocation(computeProgram, "b");
+		computeCLocation = glGetUniformLocation(computeProgram, "c");
+		computeUStepLocation = glGetUniformLocation(computeProgram, "uStep");
+	}
+
+	trailProgram = ShaderTools::compileShaders("shaders/trail.vert", "shaders/main.frag");
+	trailModelViewLocation = glGetUniformLocation(trailProgram, "modelView");
+	trailOrthoLocation = glGetUniformLocation(trailProgram, "ortho");
+	trailColorLocation = glGetUniformLocation(trailProgram, "color");
+	trailHeadLocation = glGetUniformLocation(trailProgram, "head");
+	trailCapacityLocation = glGetUniformLocation(trailProgram, "capacity");
+	trailFilledLocation = glGetUniformLocation(trailProgram, "filled");
+
+	glGenVertexArrays(1, &trailVao);
+	glBindVertexArray(trailVao);
+	glGenBuffers(1, &trailBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, trailBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+
+	densityProgram = ShaderTools::compileShaders("shaders/density.vert", "shaders/density.frag");
+	densityColorLocation = glGetUniformLocation(densityProgram, "color");
+	// the full-window triangle comes from gl_VertexID, core profile still wants some VAO bound
+	glGenVertexArrays(1, &densityVao);
+	glGenTextures(1, &densityTexture);
+	glBindTexture(GL_TEXTURE_2D, densityTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// the gallery has no vertex data at all, only one vec4 of parameters per curve
+	galleryCurves = 0;
+	glGenVertexArrays(1, &galleryVao);
+	glBindVertexArray(galleryVao);
+	glGenBuffers(1, &galleryInstanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, galleryInstanceBuffer);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribDivisor(0, 1);
+	glBindVertexArray(0);
 
 	// Set OpenGL state
 	glEnable(GL_DEPTH_TEST);
@@ -16,56 +92,632 @@ RenderEngine::RenderEngine(GLFWwindow* window) : window(window) {
 }
 
 // Called to render provided objects under view matrix
-void RenderEngine::render(const std::vector<Geometry*>& objects, glm::mat4 view, glm::vec4 color) {
+void RenderEngine::render(const Scene& scene, glm::mat4 view, glm::vec4 color) {
+	PROFILE_ZONE("render");
 	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 	glUseProgram(mainProgram);
 
-	for (const Geometry* o : objects) {
-		glBindVertexArray(o->vao);
+	// vertices written by the compute shader have to land before they are pulled as attributes
+	if (computeWrites) {
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		computeWrites = false;
+	}
 
-		glm::mat4 modelView = view * o->modelMatrix;
-		glUniformMatrix4fv(glGetUniformLocation(mainProgram, "modelView"), 1, GL_FALSE, glm::value_ptr(modelView));
-		glUniformMatrix4fv(glGetUniformLocation(mainProgram, "ortho"), 1, GL_FALSE, glm::value_ptr(ortho));
-		glUniform4fv(glGetUniformLocation(mainProgram, "color"), 1, &color[0]);
-		
+	glUniformMatrix4fv(orthoLocation, 1, GL_FALSE, glm::value_ptr(ortho));
+	glUniform4fv(colorLocation, 1, &color[0]);
 
-		glDrawArrays(o->drawMode, 0, o->verts.size());
-		// glDrawArrays(o->drawMode, 0, o->verts.size());
-		glBindVertexArray(0);
+	// Copy angles are wrapped to [0, 2 pi) here in double, so copies many turns along keep their angle and the
+	// shader stays in float. Geometry without copies reads the attribute's current value, no turn at all.
+	copyAngles.clear();
+	for (size_t i = 0; i < scene.size(); i++) {
+		const RotatedCopies& rotated = scene.rotatedCopies[i];
+		if (scene.counts[i] == 0 || rotated.angle == 0.0) {
+			continue;
+		}
+		GLsizei copies = rotated.copies + (rotated.tailCount > 0 ? 1 : 0);
+		for (GLsizei c = 0; c < copies; c++) {
+			copyAngles.push_back((float)std::fmod((rotated.firstCopy + c) * rotated.angle, TWO_PI));
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, copyAngleBuffer);
+	if (!copyAngles.empty()) {
+		glBufferData(GL_ARRAY_BUFFER, copyAngles.size() * sizeof(float), copyAngles.data(), GL_STREAM_DRAW);
+	}
+	glVertexAttrib1f(1, 0.0f);
+	size_t copyAngleOffset = 0;
+
+	for (size_t i = 0; i < scene.size(); i++) {
+		if (scene.counts[i] == 0) {
+			continue;
+		}
+		glBindVertexArray(scene.vaos[i]);
+
+		glm::mat4 modelView = cameraRelative(scene.origins[i]) * view * scene.modelMatrices[i];
+		glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, glm::value_ptr(modelView));
+
+		// shared VAOs point at their own run of angles on every draw
+		const RotatedCopies& rotated = scene.rotatedCopies[i];
+		if (rotated.angle != 0.0) {
+			glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, (void*)(copyAngleOffset * sizeof(float)));
+			glVertexAttribDivisor(1, 1);
+			glEnableVertexAttribArray(1);
+			copyAngleOffset += rotated.copies + (rotated.tailCount > 0 ? 1 : 0);
+		}
+		else {
+			glDisableVertexAttribArray(1);
+		}
+
+		const DrawRanges& ranges = scene.multiRanges[i];
+		if (rotated.copies != 1 || rotated.tailCount > 0) {
+			// one instance per whole copy, then the partial one on its own, reading the angle after theirs
+			if (rotated.copies > 0) {
+				glDrawArraysInstanced(scene.drawModes[i], scene.firsts[i], scene.counts[i], rotated.copies);
+			}
+			if (rotated.tailCount > 0) {
+				glDrawArraysInstancedBaseInstance(scene.drawModes[i], scene.firsts[i], glm::min(rotated.tailCount, scene.counts[i]), 1, rotated.copies);
+			}
+		}
+		else if (ranges.firsts.empty()) {
+			glDrawArrays(scene.drawModes[i], scene.firsts[i], scene.counts[i]);
+		}
+		else {
+			glMultiDrawArrays(scene.drawModes[i], ranges.firsts.data(), ranges.counts.data(), (GLsizei)ranges.firsts.size());
+		}
 	}
+	glBindVertexArray(0);
 }
 
 // Assigns and binds buffers
-void RenderEngine::assignBuffers(Geometry& object) {
+void RenderEngine::assignBuffers(Scene& scene, GeometryHandle object) {
+	size_t i = scene.index(object);
+
 	// Bind attribute array for triangles
-	glGenVertexArrays(1, &object.vao);
-	glBindVertexArray(object.vao);
+	glGenVertexArrays(1, &scene.vaos[i]);
+	glBindVertexArray(scene.vaos[i]);
 
 	// Vertex buffer
-	glGenBuffers(1, &object.vertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, object.vertexBuffer);
+	glGenBuffers(1, &scene.vertexBuffers[i]);
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffers[i]);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 	glEnableVertexAttribArray(0);
 
 	glBindVertexArray(0);
 }
 
+void RenderEngine::shareBuffers(Scene& scene, GeometryHandle object, GeometryHandle source) {
+	size_t i = scene.index(object);
+	scene.vaos[i] = scene.vaos[scene.index(source)];
+	scene.vertexBuffers[i] = 0;
+}
+
 // Updates geometry in buffer
-void RenderEngine::updateBuffers(Geometry& object) {
-	// Updates data in buffer
-	glBindBuffer(GL_ARRAY_BUFFER, object.vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * object.verts.size(), object.verts.data(), GL_DYNAMIC_DRAW);
+void RenderEngine::updateBuffers(Scene& scene, GeometryHandle object) {
+	PROFILE_ZONE("updateBuffers");
+	size_t i = scene.index(object);
+	const VertexArray& verts = *scene.vertices[i];
+	GLsizeiptr size = sizeof(glm::vec3) * verts.size();
+	scene.setDrawRange(object, 0, (GLsizei)verts.size());
+	scene.computedCounts[i] = 0;
+	scene.contentChanged[i] = 1;
+
+	// every strategy but the first keeps a buffer that only grows, by doubling
+	GLsizeiptr capacity = scene.bufferCapacities[i];
+	GLsizeiptr grown = glm::max(size, capacity * 2);
+	bool persistent = scene.mappedBuffers[i] != nullptr;
+
+	if (uploadStrategy == UPLOAD_PERSISTENT) {
+		if (!persistent || size > capacity) {
+			replaceBuffer(scene, i, true, grown);
+		}
+		if (size == 0) {
+			return;
+		}
+		// Retire the region drawn from so far and move on to the one retired longest ago. Its fence went in
+		// REGIONS - 1 uploads back, so it has normally signalled and the wait returns at once.
+		BufferRing& ring = scene.bufferRings[i];
+		ring.fences[ring.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		ring.region = (ring.region + 1) % BufferRing::REGIONS;
+		GLsync& fence = ring.fences[ring.region];
+		if (fence != nullptr) {
+			PROFILE_ZONE("waitRegion");
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		GLsizeiptr offset = ring.region * scene.bufferCapacities[i];
+		memcpy((char*)scene.mappedBuffers[i] + offset, verts.data(), size);
+
+		glBindVertexArray(scene.vaos[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffers[i]);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)offset);
+		glBindVertexArray(0);
+		return;
+	}
+
+	if (persistent) {
+		replaceBuffer(scene, i, false, 0);
+		capacity = 0;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffers[i]);
+
+	switch (uploadStrategy) {
+	case UPLOAD_BUFFER_DATA:
+		glBufferData(GL_ARRAY_BUFFER, size, verts.data(), GL_DYNAMIC_DRAW);
+		scene.bufferCapacities[i] = size;
+		break;
+
+	case UPLOAD_ORPHAN:
+		scene.bufferCapacities[i] = size > capacity ? grown : capacity;
+		glBufferData(GL_ARRAY_BUFFER, scene.bufferCapacities[i], nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, verts.data());
+		break;
+
+	case UPLOAD_SUB_DATA:
+		if (size > capacity) {
+			glBufferData(GL_ARRAY_BUFFER, grown, nullptr, GL_DYNAMIC_DRAW);
+			scene.bufferCapacities[i] = grown;
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, verts.data());
+		break;
+
+	case UPLOAD_MAP_RANGE:
+		if (size > capacity) {
+			glBufferData(GL_ARRAY_BUFFER, grown, nullptr, GL_DYNAMIC_DRAW);
+			scene.bufferCapacities[i] = grown;
+		}
+		if (size > 0) {
+			void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (mapped != nullptr) {
+				memcpy(mapped, verts.data(), size);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void RenderEngine::replaceBuffer(Scene& scene, size_t i, bool persistent, GLsizeiptr capacity) {
+	// deleting a mapped buffer unmaps it
+	glDeleteBuffers(1, &scene.vertexBuffers[i]);
+	glGenBuffers(1, &scene.vertexBuffers[i]);
+	glBindVertexArray(scene.vaos[i]);
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffers[i]);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glBindVertexArray(0);
+
+	scene.mappedBuffers[i] = nullptr;
+	scene.bufferCapacities[i] = 0;
+	resetRing(scene, i);
+	if (persistent) {
+		// zero sized storage is an error, keep at least one vertex; the capacity is per region
+		capacity = glm::max(capacity, (GLsizeiptr)sizeof(glm::vec3));
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, capacity * BufferRing::REGIONS, nullptr, flags);
+		scene.mappedBuffers[i] = glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity * BufferRing::REGIONS, flags);
+		scene.bufferCapacities[i] = capacity;
+	}
+}
+
+void RenderEngine::resetRing(Scene& scene, size_t i) {
+	BufferRing& ring = scene.bufferRings[i];
+	for (GLsync& fence : ring.fences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	ring.region = 0;
+}
+
+bool RenderEngine::setUploadStrategy(UploadStrategy strategy) {
+	if (strategy == UPLOAD_PERSISTENT && !GLEW_ARB_buffer_storage) {
+		return false;
+	}
+	uploadStrategy = strategy;
+	return true;
+}
+
+const char* RenderEngine::uploadStrategyName(UploadStrategy strategy) {
+	switch (strategy) {
+	case UPLOAD_BUFFER_DATA: return "glBufferData";
+	case UPLOAD_ORPHAN: return "orphan + glBufferSubData";
+	case UPLOAD_SUB_DATA: return "glBufferSubData";
+	case UPLOAD_MAP_RANGE: return "glMapBufferRange";
+	case UPLOAD_PERSISTENT: return "persistent mapping";
+	default: return "unknown";
+	}
 }
 
 // Deletes buffers
-void RenderEngine::deleteBuffers(Geometry& object) {
-	glDeleteBuffers(1, &object.vertexBuffer);
-	glDeleteVertexArrays(1, &object.vao);
+void RenderEngine::deleteBuffers(Scene& scene, GeometryHandle object) {
+	size_t i = scene.index(object);
+	// geometry sharing another one's buffer leaves it to the owner
+	if (scene.vertexBuffers[i] != 0) {
+		glDeleteBuffers(1, &scene.vertexBuffers[i]);
+		glDeleteVertexArrays(1, &scene.vaos[i]);
+	}
+	scene.counts[i] = 0;
+	scene.bufferCapacities[i] = 0;
+	scene.mappedBuffers[i] = nullptr;
+	resetRing(scene, i);
+}
+
+// Deletes the buffers of every geometry in the scene in one go
+void RenderEngine::releaseScene(Scene& scene) {
+	// shared vertex arrays show up twice, GL ignores names that were already deleted
+	glDeleteBuffers((GLsizei)scene.size(), scene.vertexBuffers.data());
+	glDeleteVertexArrays((GLsizei)scene.size(), scene.vaos.data());
+	for (size_t i = 0; i < scene.size(); i++) {
+		scene.vertexBuffers[i] = 0;
+		scene.vaos[i] = 0;
+		scene.counts[i] = 0;
+		scene.bufferCapacities[i] = 0;
+		scene.mappedBuffers[i] = nullptr;
+		resetRing(scene, i);
+	}
+}
+
+// Curve selectors and work group size of shaders/curve.comp
+static const GLint COMPUTE_HYPOCYCLOID = 0;
+static const GLint COMPUTE_CIRCLE = 1;
+static const GLint COMPUTE_QUADRATIC = 2;
+static const size_t COMPUTE_GROUP_SIZE = 256;
+// the smallest limit on work groups per dimension GL guarantees
+static const size_t COMPUTE_MAX_GROUPS = 65535;
+// custom curve shaders kept at once
+static const size_t MAX_EXPRESSION_PROGRAMS = 64;
+
+void RenderEngine::computeHypocycloid(Scene& scene, GeometryHandle object, const CurveParams& params, size_t count) {
+	glUseProgram(computeProgram);
+	glUniform1f(computeOuterRadiusLocation, params.outerRadius);
+	glUniform1f(computeInnerRadiusLocation, params.innerRadius);
+	glUniform1i(computeStepLocation, params.step);
+	dispatchCurve(scene, object, COMPUTE_HYPOCYCLOID, count);
+}
+
+void RenderEngine::computeCircle(Scene& scene, GeometryHandle object, glm::vec3 center, float radius, int detail) {
+	glUseProgram(computeProgram);
+	glUniform3fv(computeCenterLocation, 1, &center[0]);
+	glUniform1f(computeRadiusLocation, radius);
+	glUniform1i(computeDetailLocation, detail);
+	dispatchCurve(scene, object, COMPUTE_CIRCLE, CurveGenerator::circleSampleCount(detail));
+}
+
+void RenderEngine::computeQuadratic(Scene& scene, GeometryHandle object, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float uStep) {
+	glUseProgram(computeProgram);
+	glUniform3fv(computeALocation, 1, &a[0]);
+	glUniform3fv(computeBLocation, 1, &b[0]);
+	glUniform3fv(computeCLocation, 1, &c[0]);
+	glUniform1f(computeUStepLocation, uStep);
+	dispatchCurve(scene, object, COMPUTE_QUADRATIC, CurveGenerator::quadraticSampleCount(uStep));
+}
+
+bool RenderEngine::computeExpression(Scene& scene, GeometryHandle object, const CurveExpression& expression, const float* parameters,
+	double t0, double dt, size_t count) {
+	// needs the same extensions as curve.comp
+	if (computeProgram == 0) {
+		return false;
+	}
+	uint64_t hash = expression.hash();
+	auto found = expressionPrograms.find(hash);
+	if (found == expressionPrograms.end()) {
+		PROFILE_ZONE("compileExpression");
+		if (expressionOrder.size() == MAX_EXPRESSION_PROGRAMS) {
+			glDeleteProgram(expressionPrograms[expressionOrder.front()].program);
+			expressionPrograms.erase(expressionOrder.front());
+			expressionOrder.pop_front();
+		}
+		ExpressionProgram compiled;
+		compiled.program = ShaderTools::compileComputeShader("shaders/expression.comp", expression.glsl());
+		compiled.firstLocation = glGetUniformLocation(compiled.program, "first");
+		compiled.countLocation = glGetUniformLocation(compiled.program, "count");
+		compiled.t0Location = glGetUniformLocation(compiled.program, "t0");
+		compiled.dtLocation = glGetUniformLocation(compiled.program, "dt");
+		compiled.parametersLocation = glGetUniformLocation(compiled.program, "parameters");
+		// a shader that didn't build is kept too, so it isn't retried every frame
+		found = expressionPrograms.emplace(hash, compiled).first;
+		expressionOrder.push_back(hash);
+	}
+	const ExpressionProgram& compiled = found->second;
+	if (compiled.program == 0) {
+		return false;
+	}
+
+	glUseProgram(compiled.program);
+	if (!expression.parameterNames().empty()) {
+		glUniform1fv(compiled.parametersLocation, (GLsizei)expression.parameterNames().size(), parameters);
+	}
+	glUniform1d(compiled.t0Location, t0);
+	glUniform1d(compiled.dtLocation, dt);
+	dispatch(scene, object, count, compiled.firstLocation, compiled.countLocation);
+	return true;
+}
+
+void RenderEngine::dispatchCurve(Scene& scene, GeometryHandle object, GLint curve, size_t count) {
+	glUniform1i(computeCurveLocation, curve);
+	dispatch(scene, object, count, computeFirstLocation, computeCountLocation);
+}
+
+void RenderEngine::dispatch(Scene& scene, GeometryHandle object, size_t count, GLint firstLocation, GLint countLocation) {
+	PROFILE_ZONE("dispatchCurve");
+	size_t i = scene.index(object);
+	// the CPU copy would be stale, so there is none
+	scene.vertices[i]->clear();
+	scene.setDrawRange(object, 0, (GLsizei)count);
+	scene.computedCounts[i] = count;
+	scene.contentChanged[i] = 1;
+
+	// a persistently mapped buffer belongs to the CPU, the shader gets an ordinary one
+	if (scene.mappedBuffers[i] != nullptr) {
+		replaceBuffer(scene, i, false, 0);
+	}
+	GLsizeiptr size = sizeof(glm::vec3) * count;
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffers[i]);
+	if (size > scene.bufferCapacities[i]) {
+		GLsizeiptr grown = glm::max(size, scene.bufferCapacities[i] * 2);
+		glBufferData(GL_ARRAY_BUFFER, grown, nullptr, GL_DYNAMIC_COPY);
+		scene.bufferCapacities[i] = grown;
+	}
+	if (count == 0) {
+		return;
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, scene.vertexBuffers[i]);
+	// split so no dispatch asks for more groups than every implementation allows
+	size_t perDispatch = COMPUTE_GROUP_SIZE * COMPUTE_MAX_GROUPS;
+	for (size_t first = 0; first < count; first += perDispatch) {
+		size_t batch = glm::min(perDispatch, count - first);
+		glUniform1ui(firstLocation, (GLuint)first);
+		glUniform1ui(countLocation, (GLuint)batch);
+		glDispatchCompute((GLuint)((batch + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE), 1, 1);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+	computeWrites = true;
+}
+
+void RenderEngine::readBack(Scene& scene, GeometryHandle object) {
+	size_t i = scene.index(object);
+	if (scene.vertexBuffers[i] == 0) {
+		return;
+	}
+
+	// everything up to the end of the last range that is drawn
+	const DrawRanges& ranges = scene.multiRanges[i];
+	size_t count = (size_t)scene.firsts[i] + scene.counts[i];
+	for (size_t r = 0; r < ranges.firsts.size(); r++) {
+		count = glm::max(count, (size_t)ranges.firsts[r] + ranges.counts[r]);
+	}
+	count = glm::min(count, (size_t)scene.bufferCapacities[i] / sizeof(glm::vec3));
+
+	VertexArray& verts = *scene.vertices[i];
+	verts.resize(count);
+	readBuffer(scene, i, count, verts.data());
+}
+
+void RenderEngine::readComputed(const Scene& scene, size_t i, std::vector<glm::vec3>& out) {
+	size_t count = scene.vertexBuffers[i] != 0 ? scene.computedCounts[i] : 0;
+	out.resize(glm::min(count, (size_t)scene.bufferCapacities[i] / sizeof(glm::vec3)));
+	readBuffer(scene, i, out.size(), out.data());
+}
+
+void RenderEngine::readBuffer(const Scene& scene, size_t i, size_t count, glm::vec3* out) {
+	if (count == 0) {
+		return;
+	}
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_ARRAY_BUFFER, scene.vertexBuffers[i]);
+	// a persistent buffer is drawn from its current region
+	GLintptr offset = scene.mappedBuffers[i] != nullptr ? scene.bufferRings[i].region * scene.bufferCapacities[i] : 0;
+	glGetBufferSubData(GL_ARRAY_BUFFER, offset, sizeof(glm::vec3) * count, out);
+}
+
+// Allocates the ring once, appending never reallocates
+void RenderEngine::setTrailCapacity(size_t capacity) {
+	trailCapacity = capacity;
+	glBindBuffer(GL_ARRAY_BUFFER, trailBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * (capacity + 1), nullptr, GL_DYNAMIC_DRAW);
+	clearTrail();
+}
+
+void RenderEngine::clearTrail() {
+	trailHead = 0;
+	trailFilled = 0;
+}
+
+void RenderEngine::appendTrail(const glm::vec3* verts, size_t count) {
+	if (trailCapacity == 0) {
+		return;
+	}
+	// anything before the last capacity samples would be overwritten within this call anyway
+	if (count > trailCapacity) {
+		verts += count - trailCapacity;
+		count = trailCapacity;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, trailBuffer);
+	while (count > 0) {
+		size_t n = glm::min(count, trailCapacity - trailHead);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * trailHead, sizeof(glm::vec3) * n, verts);
+		if (trailHead == 0) {
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * trailCapacity, sizeof(glm::vec3), verts);
+		}
+		trailHead = (trailHead + n) % trailCapacity;
+		trailFilled = glm::min(trailFilled + n, trailCapacity);
+		verts += n;
+		count -= n;
+	}
+}
+
+// Draws the ring oldest to newest as at most two strips, on top of whatever render() drew
+void RenderEngine::renderTrail(glm::mat4 modelView, glm::vec4 color, bool drawHead) {
+	if (trailFilled == 0) {
+		return;
+	}
+
+	glUseProgram(trailProgram);
+	modelView = cameraRelative(glm::dvec2(0.0)) * modelView;
+	glUniformMatrix4fv(trailModelViewLocation, 1, GL_FALSE, glm::value_ptr(modelView));
+	glUniformMatrix4fv(trailOrthoLocation, 1, GL_FALSE, glm::value_ptr(ortho));
+	glUniform4fv(trailColorLocation, 1, &color[0]);
+	glUniform1i(trailHeadLocation, (GLint)trailHead);
+	glUniform1i(trailCapacityLocation, (GLint)trailCapacity);
+	glUniform1i(trailFilledLocation, (GLint)trailFilled);
+
+	// the fade needs blending, and the trail would lose depth tests against the curves at the same z
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+
+	glBindVertexArray(trailVao);
+	if (trailFilled < trailCapacity || trailHead == 0) {
+		glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)trailFilled);
+	}
+	else {
+		// the older half runs through the copy of slot 0 at the end, where the newer half starts
+		GLint firsts[2] = { (GLint)trailHead, 0 };
+		GLsizei counts[2] = { (GLsizei)(trailCapacity + 1 - trailHead), (GLsizei)trailHead };
+		glMultiDrawArrays(GL_LINE_STRIP, firsts, counts, 2);
+	}
+	if (drawHead) {
+		glDrawArrays(GL_POINTS, (GLint)((trailHead + trailCapacity - 1) % trailCapacity), 1);
+	}
+	glBindVertexArray(0);
+
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+}
+
+void RenderEngine::setDensityImage(int width, int height, const uint8_t* pixels) {
+	PROFILE_ZONE("setDensityImage");
+	glBindTexture(GL_TEXTURE_2D, densityTexture);
+	// rows of one byte aren't 4-byte aligned for odd widths
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (width != densityWidth || height != densityHeight) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+		densityWidth = width;
+		densityHeight = height;
+	}
+	else {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, pixels);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// One pixel of the image per window pixel, on top of whatever render() drew
+void RenderEngine::renderDensity(glm::vec4 color) {
+	if (densityWidth == 0 || densityHeight == 0) {
+		return;
+	}
+
+	glUseProgram(densityProgram);
+	glUniform4fv(densityColorLocation, 1, &color[0]);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, densityTexture);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+
+	glBindVertexArray(densityVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+}
+
+// Uploads the per-instance parameters of the gallery
+void RenderEngine::setGalleryCurves(const glm::vec4* curves, size_t count) {
+	glBindBuffer(GL_ARRAY_BUFFER, galleryInstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * count, curves, GL_STATIC_DRAW);
+	galleryCurves = (GLsizei)count;
+}
+
+// Draws every curve of the gallery with a single instanced draw, positions are computed in the vertex shader
+void RenderEngine::renderGallery(GLsizei samples, float thetaMax, float cellSize, float rotation, glm::mat4 view, glm::vec4 color) {
+	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	if (galleryCurves == 0 || samples < 2) {
+		return;
+	}
+
+	glUseProgram(galleryProgram);
+	glm::mat4 modelView = cameraRelative(glm::dvec2(0.0)) * view;
+	glUniformMatrix4fv(galleryModelViewLocation, 1, GL_FALSE, glm::value_ptr(modelView));
+	glUniformMatrix4fv(galleryOrthoLocation, 1, GL_FALSE, glm::value_ptr(ortho));
+	glUniform4fv(galleryColorLocation, 1, &color[0]);
+	glUniform1i(gallerySamplesLocation, samples);
+	glUniform1f(galleryThetaMaxLocation, thetaMax);
+	glUniform1f(galleryCellSizeLocation, cellSize);
+	glUniform1f(galleryRotationLocation, rotation);
+
+	glBindVertexArray(galleryVao);
+	glDrawArraysInstanced(GL_LINE_STRIP, 0, samples, galleryCurves);
+	glBindVertexArray(0);
 }
 
 // Sets projection and viewport for new width and height
 void RenderEngine::setWindowSize(int width, int height) {
 	glViewport(0, 0, width, height);
-	float aspectRatio = ((float)width / (float)height);
-	ortho = glm::ortho(-10.0f * aspectRatio, 10.0f * aspectRatio, -10.0f, 10.0f, -1.0f, 1.0f);
+	windowWidth = width;
+	windowHeight = height;
+	updateProjection();
+}
+
+// Deep enough to need double positions, shallow enough that doubles still resolve a pixel on the curve
+static const double MAX_ZOOM = 1e10;
+
+// Keeps the world point under the cursor in place while zooming
+void RenderEngine::zoomAt(double x, double y, float factor) {
+	glm::dvec2 fromCenter = glm::dvec2(x - windowWidth * 0.5, windowHeight * 0.5 - y);
+	double before = 20.0 / (cameraZoom * glm::max(windowHeight, 1));
+	cameraZoom = glm::clamp(cameraZoom * factor, 1e-3, MAX_ZOOM);
+	double after = 20.0 / (cameraZoom * glm::max(windowHeight, 1));
+	cameraCenter += fromCenter * (before - after);
+	updateProjection();
+}
+
+void RenderEngine::pan(double dx, double dy) {
+	cameraCenter += glm::dvec2(-dx, dy) * (20.0 / (cameraZoom * glm::max(windowHeight, 1)));
+	updateProjection();
+}
+
+void RenderEngine::resetCamera() {
+	cameraCenter = glm::dvec2(0.0);
+	cameraZoom = 1.0;
+	updateProjection();
+}
+
+glm::dvec2 RenderEngine::screenToWorld(double x, double y) const {
+	glm::dvec2 fromCenter = glm::dvec2(x - windowWidth * 0.5, windowHeight * 0.5 - y);
+	return cameraCenter + fromCenter * (20.0 / (cameraZoom * glm::max(windowHeight, 1)));
+}
+
+void RenderEngine::visibleBounds(glm::dvec2& min, glm::dvec2& max) const {
+	min = cameraCenter - viewHalfSize();
+	max = cameraCenter + viewHalfSize();
+}
+
+glm::dvec2 RenderEngine::viewHalfSize() const {
+	return glm::dvec2(windowWidth, windowHeight) * (10.0 / (cameraZoom * glm::max(windowHeight, 1)));
+}
+
+float RenderEngine::worldPerPixel() const {
+	return (float)(20.0 / (cameraZoom * glm::max(windowHeight, 1)));
+}
+
+glm::mat4 RenderEngine::cameraRelative(glm::dvec2 origin) const {
+	// the difference is taken in double, only the small result is rounded
+	glm::vec2 shift = glm::vec2(origin - cameraCenter);
+	return glm::translate(glm::mat4(1.f), glm::vec3(shift, 0.f));
+}
+
+void RenderEngine::updateProjection() {
+	glm::vec2 halfSize = glm::vec2(viewHalfSize());
+	ortho = glm::ortho(-halfSize.x, halfSize.x, -halfSize.y, halfSize.y, -1.0f, 1.0f);
+	cameraChanges++;
 }
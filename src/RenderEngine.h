@@ -7,27 +7,197 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
 #include <vector>
 
-#include "Geometry.h"
+#include "CurveExpression.h"
+#include "CurveGenerator.h"
+#include "Scene.h"
 #include "ShaderTools.h"
 
+// Ways updateBuffers can get vertices into a buffer, see UploadBenchmark for how they compare
+enum UploadStrategy {
+	// glBufferData with the exact size every time
+	UPLOAD_BUFFER_DATA,
+	// glBufferData(nullptr) on the whole buffer to orphan it, then glBufferSubData
+	UPLOAD_ORPHAN,
+	// glBufferSubData into a buffer that only grows
+	UPLOAD_SUB_DATA,
+	// glMapBufferRange with invalidate and unsynchronized flags, then memcpy
+	UPLOAD_MAP_RANGE,
+	// immutable storage mapped once with persistent coherent flags, cycling through the regions of a BufferRing
+	UPLOAD_PERSISTENT,
+	UPLOAD_STRATEGY_COUNT
+};
+
 class RenderEngine {
 
 public:
 	RenderEngine(GLFWwindow* window);
 
-	void render(const std::vector<Geometry*>& objects, glm::mat4 view, glm::vec4 color);
-	void assignBuffers(Geometry& object);
-	void updateBuffers(Geometry& object);
-	void deleteBuffers(Geometry& object);
+	void render(const Scene& scene, glm::mat4 view, glm::vec4 color);
+	void assignBuffers(Scene& scene, GeometryHandle object);
+	// Draws object from source's buffer instead of giving it one of its own; only source uploads
+	void shareBuffers(Scene& scene, GeometryHandle object, GeometryHandle source);
+	void updateBuffers(Scene& scene, GeometryHandle object);
+	void deleteBuffers(Scene& scene, GeometryHandle object);
+	void releaseScene(Scene& scene);
+
+	// Returns false, keeping the current strategy, if the driver can't do it
+	bool setUploadStrategy(UploadStrategy strategy);
+	UploadStrategy getUploadStrategy() const { return uploadStrategy; }
+	static const char* uploadStrategyName(UploadStrategy strategy);
+
+	// Evaluates curves with the compute shader straight into geometry's vertex buffer, leaving its VertexArray
+	// empty. render() puts a barrier between these writes and the draws that read them.
+	bool computeSupported() const { return computeProgram != 0; }
+	void computeHypocycloid(Scene& scene, GeometryHandle object, const CurveParams& params, size_t count);
+	void computeCircle(Scene& scene, GeometryHandle object, glm::vec3 center, float radius, int detail);
+	void computeQuadratic(Scene& scene, GeometryHandle object, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float uStep);
+	// A custom curve at t = t0 + i * dt for count samples. Each distinct expression is compiled to its own shader
+	// once, so new parameter values only change uniforms. Returns false if the shader can't be built, and the
+	// caller evaluates the curve on the CPU instead.
+	bool computeExpression(Scene& scene, GeometryHandle object, const CurveExpression& expression, const float* parameters,
+		double t0, double dt, size_t count);
+	// Copies the vertices object currently draws back into its VertexArray, e.g. to export what the GPU made
+	void readBack(Scene& scene, GeometryHandle object);
+	// Copies the computedCounts[i] vertices the compute shader wrote into geometry i's buffer into out
+	void readComputed(const Scene& scene, size_t i, std::vector<glm::vec3>& out);
+
+	// Trail of the most recent samples in a fixed-size ring buffer, so an endless animation uses fixed memory.
+	// Older samples fade out by age; resizing or clearing drops everything in it.
+	void setTrailCapacity(size_t capacity);
+	size_t getTrailCapacity() const { return trailCapacity; }
+	void clearTrail();
+	void appendTrail(const glm::vec3* verts, size_t count);
+	void renderTrail(glm::mat4 modelView, glm::vec4 color, bool drawHead);
+
+	// Tone mapped DensityMap image the size of the window, rows top to bottom, blended over the scene by
+	// renderDensity. A new size reallocates the texture, anything else only updates it.
+	void setDensityImage(int width, int height, const uint8_t* pixels);
+	void renderDensity(glm::vec4 color);
+
+	// Gallery of hypocycloids evaluated on the GPU, one instance per (outer radius, inner radius, cell center)
+	void setGalleryCurves(const glm::vec4* curves, size_t count);
+	void renderGallery(GLsizei samples, float thetaMax, float cellSize, float rotation, glm::mat4 view, glm::vec4 color);
 	void setWindowSize(int width, int height);
 
+	// Camera over the world, positions in window coordinates with y pointing down like GLFW's cursor
+	void zoomAt(double x, double y, float factor);
+	void pan(double dx, double dy);
+	void resetCamera();
+	// In double like the camera, subtract an anchor near the point before going to float
+	glm::dvec2 screenToWorld(double x, double y) const;
+	void visibleBounds(glm::dvec2& min, glm::dvec2& max) const;
+	float worldPerPixel() const;
+	// The camera is kept in double; everything is drawn relative to its center so float stays precise when zoomed in
+	glm::dvec2 viewCenter() const { return cameraCenter; }
+	glm::dvec2 viewHalfSize() const;
+	// moves geometry relative to origin into the camera-relative space the projection expects
+	glm::mat4 cameraRelative(glm::dvec2 origin) const;
+	// bumped whenever the camera moves, so dependent geometry knows to regenerate
+	unsigned int cameraVersion() const { return cameraChanges; }
+
 private:
+	static constexpr double TWO_PI = 6.28318530717958647692;
+
+	void updateProjection();
+
+	// gives geometry i a fresh buffer object, immutable storage can't be resized or respecified
+	void replaceBuffer(Scene& scene, size_t i, bool persistent, GLsizeiptr capacity);
+	// deletes the fences of geometry i's ring and starts it over at the first region
+	void resetRing(Scene& scene, size_t i);
+	// reads count vertices from where geometry i is drawn from
+	void readBuffer(const Scene& scene, size_t i, size_t count, glm::vec3* out);
+	// grows geometry i's buffer to hold count vertices, binds it as the compute output and runs the shader over it
+	void dispatchCurve(Scene& scene, GeometryHandle object, GLint curve, size_t count);
+	// the same for whichever compute program is bound, given where its first and count uniforms are
+	void dispatch(Scene& scene, GeometryHandle object, size_t count, GLint firstLocation, GLint countLocation);
+
 	GLFWwindow* window;
 
+	UploadStrategy uploadStrategy;
+
 	GLuint mainProgram;
+	GLint modelViewLocation;
+	GLint orthoLocation;
+	GLint colorLocation;
+	GLuint copyAngleBuffer;
+	std::vector<float> copyAngles;
+
+	GLuint computeProgram;
+	GLint computeCurveLocation;
+	GLint computeFirstLocation;
+	GLint computeCountLocation;
+	GLint computeOuterRadiusLocation;
+	GLint computeInnerRadiusLocation;
+	GLint computeStepLocation;
+	GLint computeCenterLocation;
+	GLint computeRadiusLocation;
+	GLint computeDetailLocation;
+	GLint computeALocation;
+	GLint computeBLocation;
+	GLint computeCLocation;
+	GLint computeUStepLocation;
+	// set by compute dispatches until render() issues the barrier for them
+	bool computeWrites;
+
+	// shaders/expression.comp compiled with a custom curve, program 0 if that failed
+	struct ExpressionProgram {
+		GLuint program;
+		GLint firstLocation;
+		GLint countLocation;
+		GLint t0Location;
+		GLint dtLocation;
+		GLint parametersLocation;
+	};
+	// by CurveExpression::hash, and the hashes in the order they were compiled so the oldest can be dropped;
+	// typing an expression compiles a shader for every prefix of it that parses
+	std::unordered_map<uint64_t, ExpressionProgram> expressionPrograms;
+	std::deque<uint64_t> expressionOrder;
+
+	GLuint trailProgram;
+	GLuint trailVao;
+	// capacity + 1 vertices, the last one a copy of the first
+	GLuint trailBuffer;
+	size_t trailCapacity;
+	size_t trailHead;
+	size_t trailFilled;
+	GLint trailModelViewLocation;
+	GLint trailOrthoLocation;
+	GLint trailColorLocation;
+	GLint trailHeadLocation;
+	GLint trailCapacityLocation;
+	GLint trailFilledLocation;
+
+	GLuint densityProgram;
+	GLint densityColorLocation;
+	GLuint densityVao;
+	GLuint densityTexture;
+	int densityWidth;
+	int densityHeight;
+
+	GLuint galleryProgram;
+	GLuint galleryVao;
+	GLuint galleryInstanceBuffer;
+	GLsizei galleryCurves;
+	GLint galleryModelViewLocation;
+	GLint galleryOrthoLocation;
+	GLint galleryColorLocation;
+	GLint gallerySamplesLocation;
+	GLint galleryThetaMaxLocation;
+	GLint galleryCellSizeLocation;
+	GLint galleryRotationLocation;
 
+	// projection of the view around the camera center, see cameraRelative
 	glm::mat4 ortho;
+	int windowWidth;
+	int windowHeight;
+	// world point at the middle of the window and how much it is magnified over the default +-10 units
+	glm::dvec2 cameraCenter;
+	double cameraZoom;
+	unsigned int cameraChanges;
 };
 
@@ -0,0 +1,127 @@
+#include "Scene.h"
+
+#include <new>
+
+Scene::Scene(SceneArena& arena) : arena(arena) {
+}
+
+Scene::~Scene() {
+	for (VertexArray* v : vertices) {
+		v->~VertexArray();
+	}
+}
+
+GeometryHandle Scene::create(GLenum drawMode) {
+	GeometryHandle handle;
+	if (!freeSlots.empty()) {
+		handle.slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		handle.slot = (uint32_t)slotIndex.size();
+		slotIndex.push_back(0);
+		slotGeneration.push_back(0);
+	}
+	handle.generation = slotGeneration[handle.slot];
+	slotIndex[handle.slot] = (uint32_t)vaos.size();
+	indexSlot.push_back(handle.slot);
+
+	vaos.push_back(0);
+	vertexBuffers.push_back(0);
+	drawModes.push_back(drawMode);
+	firsts.push_back(0);
+	counts.push_back(0);
+	modelMatrices.push_back(glm::mat4(1.f));
+	origins.push_back(glm::dvec2(0.0));
+	multiRanges.push_back(DrawRanges());
+	rotatedCopies.push_back(RotatedCopies());
+
+	void* memory = arena.allocate(sizeof(VertexArray), alignof(VertexArray));
+	vertices.push_back(new (memory) VertexArray(arena));
+	bufferCapacities.push_back(0);
+	mappedBuffers.push_back(nullptr);
+	bufferRings.push_back(BufferRing());
+	computedCounts.push_back(0);
+	contentHashes.push_back(0);
+	contentChanged.push_back(1);
+
+	return handle;
+}
+
+void Scene::destroy(GeometryHandle handle) {
+	if (!valid(handle)) {
+		return;
+	}
+
+	size_t removed = slotIndex[handle.slot];
+	size_t last = vaos.size() - 1;
+	vertices[removed]->~VertexArray();
+
+	// keep the arrays dense by moving the last geometry into the hole
+	vaos[removed] = vaos[last];
+	vertexBuffers[removed] = vertexBuffers[last];
+	drawModes[removed] = drawModes[last];
+	firsts[removed] = firsts[last];
+	counts[removed] = counts[last];
+	modelMatrices[removed] = modelMatrices[last];
+	origins[removed] = origins[last];
+	multiRanges[removed].firsts.swap(multiRanges[last].firsts);
+	multiRanges[removed].counts.swap(multiRanges[last].counts);
+	rotatedCopies[removed] = rotatedCopies[last];
+	vertices[removed] = vertices[last];
+	bufferCapacities[removed] = bufferCapacities[last];
+	mappedBuffers[removed] = mappedBuffers[last];
+	bufferRings[removed] = bufferRings[last];
+	computedCounts[removed] = computedCounts[last];
+	contentHashes[removed] = contentHashes[last];
+	contentChanged[removed] = contentChanged[last];
+	indexSlot[removed] = indexSlot[last];
+	slotIndex[indexSlot[removed]] = (uint32_t)removed;
+
+	vaos.pop_back();
+	vertexBuffers.pop_back();
+	drawModes.pop_back();
+	firsts.pop_back();
+	counts.pop_back();
+	modelMatrices.pop_back();
+	origins.pop_back();
+	multiRanges.pop_back();
+	rotatedCopies.pop_back();
+	vertices.pop_back();
+	bufferCapacities.pop_back();
+	mappedBuffers.pop_back();
+	bufferRings.pop_back();
+	computedCounts.pop_back();
+	contentHashes.pop_back();
+	contentChanged.pop_back();
+	indexSlot.pop_back();
+
+	slotGeneration[handle.slot]++;
+	freeSlots.push_back(handle.slot);
+}
+
+void Scene::setDrawRange(GeometryHandle handle, GLint first, GLsizei count) {
+	size_t i = index(handle);
+	firsts[i] = first;
+	counts[i] = count;
+	multiRanges[i].firsts.clear();
+	multiRanges[i].counts.clear();
+}
+
+void Scene::setDrawRanges(GeometryHandle handle, const GLint* firsts, const GLsizei* counts, size_t rangeCount) {
+	size_t i = index(handle);
+	DrawRanges& ranges = multiRanges[i];
+	ranges.firsts.assign(firsts, firsts + rangeCount);
+	ranges.counts.assign(counts, counts + rangeCount);
+
+	GLsizei total = 0;
+	for (size_t r = 0; r < rangeCount; r++) {
+		total += counts[r];
+	}
+	this->firsts[i] = 0;
+	this->counts[i] = total;
+}
+
+bool Scene::valid(GeometryHandle handle) const {
+	return handle.slot < slotGeneration.size() && slotGeneration[handle.slot] == handle.generation;
+}
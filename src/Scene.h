@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "SceneArena.h"
+#include "VertexArray.h"
+
+// Stable reference to a geometry in a Scene. Stays valid while other geometry is added or removed,
+// and goes stale (valid() returns false) once its own geometry is destroyed.
+struct GeometryHandle {
+	uint32_t slot = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+// Several disjoint vertex ranges of one buffer, drawn with a single glMultiDrawArrays
+struct DrawRanges {
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+};
+
+// The draw range repeated as copies turned about the local origin, for curves made of congruent arcs.
+// Copy c is turned by (firstCopy + c) * angle. After the whole copies comes one more that only draws the
+// first tailCount vertices of the range.
+struct RotatedCopies {
+	double angle = 0.0;
+	GLint firstCopy = 0;
+	GLsizei copies = 1;
+	GLsizei tailCount = 0;
+};
+
+// A persistently mapped buffer holds REGIONS copies of the vertices. Each upload writes the next region while the
+// GPU may still be drawing from the others, and the region it leaves gets a fence saying when nothing uses it.
+struct BufferRing {
+	static const int REGIONS = 3;
+	GLsync fences[REGIONS] = {};
+	int region = 0;
+};
+
+// Structure-of-arrays store for everything that gets drawn.
+// The per-draw data RenderEngine::render walks every frame sits in dense parallel arrays, in draw order,
+// while the CPU-side vertices live separately in the arena and are only touched when regenerating.
+class Scene {
+
+public:
+	Scene(SceneArena& arena);
+	~Scene();
+
+	GeometryHandle create(GLenum drawMode = GL_LINE_STRIP);
+	// Removes a geometry by moving the last one into its place; the caller deletes its GL buffers first
+	void destroy(GeometryHandle handle);
+	bool valid(GeometryHandle handle) const;
+	size_t size() const { return vaos.size(); }
+
+	// dense index of a geometry, only stable until the next destroy()
+	size_t index(GeometryHandle handle) const { return slotIndex[handle.slot]; }
+
+	VertexArray& verts(GeometryHandle handle) { return *vertices[index(handle)]; }
+	glm::mat4& modelMatrix(GeometryHandle handle) { return modelMatrices[index(handle)]; }
+	glm::dvec2& origin(GeometryHandle handle) { return origins[index(handle)]; }
+	RotatedCopies& copies(GeometryHandle handle) { return rotatedCopies[index(handle)]; }
+	// Draws only vertices [first, first + count) of the uploaded buffer, until the next upload
+	void setDrawRange(GeometryHandle handle, GLint first, GLsizei count);
+	// Same for several ranges at once; counts then holds their total
+	void setDrawRanges(GeometryHandle handle, const GLint* firsts, const GLsizei* counts, size_t rangeCount);
+
+	// Hot draw data, indexed by dense index
+	std::vector<GLuint> vaos;
+	std::vector<GLuint> vertexBuffers;
+	std::vector<GLenum> drawModes;
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+	std::vector<glm::mat4> modelMatrices;
+	// World position the model matrix's output is relative to. Geometry generated in double precision is stored
+	// relative to a point near the camera, so its float coordinates stay small at deep zoom.
+	std::vector<glm::dvec2> origins;
+	// Only used by geometry drawn in pieces, empty otherwise
+	std::vector<DrawRanges> multiRanges;
+	// A single unrotated copy for everything but instanced arcs
+	std::vector<RotatedCopies> rotatedCopies;
+
+	// Cold CPU-side vertices, parallel to the arrays above
+	std::vector<VertexArray*> vertices;
+	// Bytes allocated in each vertex buffer, and its persistent mapping if it has immutable storage
+	std::vector<GLsizeiptr> bufferCapacities;
+	std::vector<void*> mappedBuffers;
+	std::vector<BufferRing> bufferRings;
+	// Vertices the compute shader last wrote into each buffer, 0 for geometry uploaded from its VertexArray
+	std::vector<size_t> computedCounts;
+	// Checksum of each buffer's contents for replays to compare, and whether the buffer was written since
+	std::vector<uint64_t> contentHashes;
+	std::vector<uint8_t> contentChanged;
+
+private:
+	SceneArena& arena;
+
+	// slot -> dense index and the other way around
+	std::vector<uint32_t> slotIndex;
+	std::vector<uint32_t> slotGeneration;
+	std::vector<uint32_t> indexSlot;
+	std::vector<uint32_t> freeSlots;
+};
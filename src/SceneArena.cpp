@@ -0,0 +1,135 @@
+#include "SceneArena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Smallest run of vertices handed out, as log2 of the capacity
+static const int MIN_VERTEX_CLASS = 8;
+
+// Requests bigger than this share of a block get a block of their own
+static const size_t LARGE_FRACTION = 4;
+
+SceneArena::SceneArena(size_t blockSize) : blockSize(blockSize) {
+	storage.used = 0;
+	storage.current = 0;
+	scratchRegion.used = 0;
+	scratchRegion.current = 0;
+	for (int i = 0; i < SIZE_CLASSES; i++) {
+		freeLists[i] = nullptr;
+	}
+}
+
+SceneArena::~SceneArena() {
+	release();
+	resetScratch();
+	freeRegion(scratchRegion);
+}
+
+void* SceneArena::bump(Region& region, size_t size, size_t alignment) {
+	while (true) {
+		if (region.current < region.blocks.size()) {
+			uintptr_t base = (uintptr_t)region.blocks[region.current];
+			uintptr_t start = (base + region.used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+			if (start + size <= base + blockSize) {
+				region.used = start + size - base;
+				return (void*)start;
+			}
+			// block is full, move on to the next one (scratch regions keep theirs around between frames)
+			region.current++;
+			region.used = 0;
+			continue;
+		}
+
+		char* block = (char*)malloc(blockSize);
+		if (block == nullptr) {
+			throw std::bad_alloc();
+		}
+		region.blocks.push_back(block);
+	}
+}
+
+void* SceneArena::allocate(size_t size, size_t alignment) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (size > blockSize / LARGE_FRACTION) {
+		// malloc alignment covers everything we store
+		char* block = (char*)malloc(size);
+		if (block == nullptr) {
+			throw std::bad_alloc();
+		}
+		largeBlocks.push_back(block);
+		return block;
+	}
+	return bump(storage, size, alignment);
+}
+
+glm::vec3* SceneArena::allocateVertices(size_t& capacity) {
+	int sizeClass = MIN_VERTEX_CLASS;
+	while (((size_t)1 << sizeClass) < capacity) {
+		sizeClass++;
+	}
+	capacity = (size_t)1 << sizeClass;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		void* run = freeLists[sizeClass];
+		if (run != nullptr) {
+			freeLists[sizeClass] = *(void**)run;
+			return (glm::vec3*)run;
+		}
+	}
+	return (glm::vec3*)allocate(sizeof(glm::vec3) * capacity, 16);
+}
+
+void SceneArena::freeVertices(glm::vec3* verts, size_t capacity) {
+	int sizeClass = 0;
+	while (((size_t)1 << sizeClass) < capacity) {
+		sizeClass++;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	*(void**)verts = freeLists[sizeClass];
+	freeLists[sizeClass] = verts;
+}
+
+void* SceneArena::scratch(size_t size, size_t alignment) {
+	if (size > blockSize / LARGE_FRACTION) {
+		char* block = (char*)malloc(size);
+		if (block == nullptr) {
+			throw std::bad_alloc();
+		}
+		largeScratch.push_back(block);
+		return block;
+	}
+	return bump(scratchRegion, size, alignment);
+}
+
+void SceneArena::resetScratch() {
+	scratchRegion.current = 0;
+	scratchRegion.used = 0;
+	for (char* block : largeScratch) {
+		free(block);
+	}
+	largeScratch.clear();
+}
+
+void SceneArena::freeRegion(Region& region) {
+	for (char* block : region.blocks) {
+		free(block);
+	}
+	region.blocks.clear();
+	region.current = 0;
+	region.used = 0;
+}
+
+void SceneArena::release() {
+	std::lock_guard<std::mutex> lock(mutex);
+	freeRegion(storage);
+	for (char* block : largeBlocks) {
+		free(block);
+	}
+	largeBlocks.clear();
+	for (int i = 0; i < SIZE_CLASSES; i++) {
+		freeLists[i] = nullptr;
+	}
+}
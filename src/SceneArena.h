@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Owns the CPU-side storage of a scene (vertex array records and their vertices) in large contiguous blocks.
+// Nothing is returned to the heap until release(), which frees the whole scene at once.
+// Vertex storage comes in power of two capacities and freed runs are recycled by size,
+// so regenerating a curve reuses memory instead of going back to the allocator.
+class SceneArena {
+
+public:
+	SceneArena(size_t blockSize = 16 << 20);
+	~SceneArena();
+
+	// Thread safe, the curve worker allocates its buffers from here too
+	void* allocate(size_t size, size_t alignment);
+	glm::vec3* allocateVertices(size_t& capacity);
+	void freeVertices(glm::vec3* verts, size_t capacity);
+
+	// Transient per-frame memory, only valid until the next resetScratch(). Render thread only.
+	void* scratch(size_t size, size_t alignment);
+	void resetScratch();
+
+	// Frees all blocks at once. Whatever was built on top (see Scene) must be destroyed beforehand.
+	void release();
+
+private:
+	struct Region {
+		std::vector<char*> blocks;
+		size_t used;
+		size_t current;
+	};
+
+	void* bump(Region& region, size_t size, size_t alignment);
+	void freeRegion(Region& region);
+
+	size_t blockSize;
+	std::mutex mutex;
+
+	Region storage;
+	Region scratchRegion;
+	std::vector<char*> largeBlocks;
+	std::vector<char*> largeScratch;
+
+	// heads of intrusive lists of freed vertex runs, indexed by log2 of their capacity
+	static const int SIZE_CLASSES = 48;
+	void* freeLists[SIZE_CLASSES];
+};
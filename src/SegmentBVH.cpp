@@ -0,0 +1,190 @@
+#include "SegmentBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+// leaves and nodes per task handed to the pool
+static const size_t LEAF_GRAIN = 1024;
+static const size_t NODE_GRAIN = 16384;
+
+static const SegmentBVH::Bounds EMPTY_BOUNDS = {
+	glm::vec2(std::numeric_limits<float>::max()),
+	glm::vec2(-std::numeric_limits<float>::max())
+};
+
+void SegmentBVH::build(ThreadPool& pool, const glm::vec3* verts, size_t count) {
+	PROFILE_ZONE("buildBVH");
+	vertexCount = count;
+	size_t segments = count > 1 ? count - 1 : 0;
+	leafCount = (segments + LEAF_SIZE - 1) / LEAF_SIZE;
+	leafCapacity = 1;
+	while (leafCapacity < leafCount) {
+		leafCapacity <<= 1;
+	}
+	nodes.assign(2 * leafCapacity, EMPTY_BOUNDS);
+
+	// leaf j covers segments [j * LEAF_SIZE, (j + 1) * LEAF_SIZE), i.e. one more vertex than that
+	Bounds* leaves = nodes.data() + leafCapacity;
+	pool.parallelFor(leafCount, LEAF_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t j = begin; j < end; j++) {
+			size_t first = j * LEAF_SIZE;
+			size_t last = std::min(first + (size_t)LEAF_SIZE, segments);
+			Bounds bounds = EMPTY_BOUNDS;
+			for (size_t v = first; v <= last; v++) {
+				glm::vec2 p = glm::vec2(verts[v]);
+				bounds.min = glm::min(bounds.min, p);
+				bounds.max = glm::max(bounds.max, p);
+			}
+			leaves[j] = bounds;
+		}
+	});
+
+	// each level only reads the finished one below it
+	for (size_t level = leafCapacity / 2; level >= 1; level /= 2) {
+		pool.parallelFor(level, NODE_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t n = level + begin; n < level + end; n++) {
+				nodes[n].min = glm::min(nodes[2 * n].min, nodes[2 * n + 1].min);
+				nodes[n].max = glm::max(nodes[2 * n].max, nodes[2 * n + 1].max);
+			}
+		});
+	}
+}
+
+void SegmentBVH::clear() {
+	vertexCount = 0;
+	leafCount = 0;
+	leafCapacity = 0;
+	nodes.clear();
+}
+
+void SegmentBVH::swap(SegmentBVH& other) {
+	std::swap(vertexCount, other.vertexCount);
+	std::swap(leafCount, other.leafCount);
+	std::swap(leafCapacity, other.leafCapacity);
+	nodes.swap(other.nodes);
+}
+
+void SegmentBVH::visibleRanges(const glm::mat4& model, glm::vec2 viewMin, glm::vec2 viewMax, glm::vec2 hiddenMin, glm::vec2 hiddenMax,
+	float margin, size_t vertexLimit, std::vector<GLint>& firsts, std::vector<GLsizei>& counts) const {
+	vertexLimit = std::min(vertexLimit, vertexCount);
+	if (vertexLimit < 2) {
+		return;
+	}
+	size_t start = counts.size();
+	visible(1, 0, leafCapacity, model, viewMin, viewMax, hiddenMin, hiddenMax, margin, vertexLimit - 1, firsts, counts);
+	// ranges were collected as segment counts, a strip of n segments draws n + 1 vertices
+	for (size_t r = start; r < counts.size(); r++) {
+		counts[r]++;
+	}
+}
+
+void SegmentBVH::visible(size_t node, size_t firstLeaf, size_t leafSpan, const glm::mat4& model, glm::vec2 viewMin, glm::vec2 viewMax,
+	glm::vec2 hiddenMin, glm::vec2 hiddenMax, float margin, size_t segmentLimit, std::vector<GLint>& firsts, std::vector<GLsizei>& counts) const {
+	size_t firstSegment = firstLeaf * LEAF_SIZE;
+	if (firstSegment >= segmentLimit || firstLeaf >= leafCount) {
+		return;
+	}
+
+	// world box of the transformed local box: centre moves with the matrix, extents with its absolute value
+	const Bounds& bounds = nodes[node];
+	glm::vec2 center = glm::vec2(model * glm::vec4((bounds.min + bounds.max) * 0.5f, 0.f, 1.f));
+	glm::vec2 half = (bounds.max - bounds.min) * 0.5f;
+	glm::vec2 extent = glm::vec2(
+		std::abs(model[0][0]) * half.x + std::abs(model[1][0]) * half.y,
+		std::abs(model[0][1]) * half.x + std::abs(model[1][1]) * half.y) + margin;
+	glm::vec2 low = center - extent;
+	glm::vec2 high = center + extent;
+
+	if (low.x > viewMax.x || high.x < viewMin.x || low.y > viewMax.y || high.y < viewMin.y) {
+		return;
+	}
+	if (low.x >= hiddenMin.x && high.x <= hiddenMax.x && low.y >= hiddenMin.y && high.y <= hiddenMax.y) {
+		return;
+	}
+
+	if (leafSpan > 1) {
+		size_t halfSpan = leafSpan / 2;
+		visible(2 * node, firstLeaf, halfSpan, model, viewMin, viewMax, hiddenMin, hiddenMax, margin, segmentLimit, firsts, counts);
+		visible(2 * node + 1, firstLeaf + halfSpan, halfSpan, model, viewMin, viewMax, hiddenMin, hiddenMax, margin, segmentLimit, firsts, counts);
+		return;
+	}
+
+	// leaves are visited in order, so a leaf right after the previous range just extends it
+	size_t segments = std::min((size_t)LEAF_SIZE, segmentLimit - firstSegment);
+	if (!counts.empty() && (size_t)firsts.back() + counts.back() == firstSegment) {
+		counts.back() += (GLsizei)segments;
+	}
+	else {
+		firsts.push_back((GLint)firstSegment);
+		counts.push_back((GLsizei)segments);
+	}
+}
+
+bool SegmentBVH::nearest(const glm::vec3* verts, glm::vec2 p, size_t vertexLimit, float maxDistance, size_t& segment, float& t, glm::vec2& point) const {
+	vertexLimit = std::min(vertexLimit, vertexCount);
+	if (vertexLimit < 2) {
+		return false;
+	}
+	float best = maxDistance;
+	bool found = false;
+	size_t bestSegment = 0;
+	float bestT = 0.f;
+	glm::vec2 bestPoint;
+	nearest(1, 0, leafCapacity, verts, p, vertexLimit - 1, best, bestSegment, bestT, bestPoint);
+	if (best < maxDistance) {
+		found = true;
+		segment = bestSegment;
+		t = bestT;
+		point = bestPoint;
+	}
+	return found;
+}
+
+void SegmentBVH::nearest(size_t node, size_t firstLeaf, size_t leafSpan, const glm::vec3* verts, glm::vec2 p, size_t segmentLimit,
+	float& best, size_t& segment, float& t, glm::vec2& point) const {
+	size_t firstSegment = firstLeaf * LEAF_SIZE;
+	if (firstSegment >= segmentLimit || firstLeaf >= leafCount || distance(nodes[node], p) >= best) {
+		return;
+	}
+
+	if (leafSpan > 1) {
+		// the closer child first, so the farther one is more likely to be pruned
+		size_t halfSpan = leafSpan / 2;
+		size_t left = 2 * node;
+		size_t right = 2 * node + 1;
+		if (distance(nodes[right], p) < distance(nodes[left], p)) {
+			nearest(right, firstLeaf + halfSpan, halfSpan, verts, p, segmentLimit, best, segment, t, point);
+			nearest(left, firstLeaf, halfSpan, verts, p, segmentLimit, best, segment, t, point);
+		}
+		else {
+			nearest(left, firstLeaf, halfSpan, verts, p, segmentLimit, best, segment, t, point);
+			nearest(right, firstLeaf + halfSpan, halfSpan, verts, p, segmentLimit, best, segment, t, point);
+		}
+		return;
+	}
+
+	size_t lastSegment = std::min(firstSegment + (size_t)LEAF_SIZE, segmentLimit);
+	for (size_t s = firstSegment; s < lastSegment; s++) {
+		glm::vec2 a = glm::vec2(verts[s]);
+		glm::vec2 ab = glm::vec2(verts[s + 1]) - a;
+		float lengthSquared = glm::dot(ab, ab);
+		float along = lengthSquared > 0.f ? glm::clamp(glm::dot(p - a, ab) / lengthSquared, 0.f, 1.f) : 0.f;
+		glm::vec2 closest = a + ab * along;
+		float d = glm::length(p - closest);
+		if (d < best) {
+			best = d;
+			segment = s;
+			t = along;
+			point = closest;
+		}
+	}
+}
+
+float SegmentBVH::distance(const Bounds& bounds, glm::vec2 p) {
+	glm::vec2 outside = glm::max(glm::max(bounds.min - p, p - bounds.max), glm::vec2(0.f));
+	return glm::length(outside);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// Bounding-volume hierarchy over the segments of a line strip, for culling and picking on long curves.
+// Leaves are fixed runs of LEAF_SIZE consecutive segments and the tree above them is implicit (node n has
+// children 2n and 2n + 1), so a leaf always maps back to one contiguous range of vertices.
+class SegmentBVH {
+
+public:
+	// segments per leaf, i.e. the smallest range that gets culled on its own
+	static const size_t LEAF_SIZE = 64;
+
+	struct Bounds {
+		glm::vec2 min;
+		glm::vec2 max;
+	};
+
+	// Rebuilds the tree over verts[0, count), splitting the leaves and each level across the pool
+	void build(ThreadPool& pool, const glm::vec3* verts, size_t count);
+	void clear();
+	void swap(SegmentBVH& other);
+
+	bool empty() const { return vertexCount < 2; }
+	size_t size() const { return vertexCount; }
+
+	// Appends the vertex ranges, merged where they touch, of the leaves among the first vertexLimit vertices
+	// whose bounds under model, grown by margin, overlap [viewMin, viewMax]. Leaves that lie entirely inside
+	// [hiddenMin, hiddenMax] are skipped as well, e.g. ones under a UI panel.
+	void visibleRanges(const glm::mat4& model, glm::vec2 viewMin, glm::vec2 viewMax, glm::vec2 hiddenMin, glm::vec2 hiddenMax,
+		float margin, size_t vertexLimit, std::vector<GLint>& firsts, std::vector<GLsizei>& counts) const;
+
+	// Closest point to p on the first vertexLimit vertices of the strip the tree was built over, in the strip's
+	// own coordinates. Returns false if nothing lies within maxDistance. segment is the index of the segment's
+	// first vertex and t how far along it the point is.
+	bool nearest(const glm::vec3* verts, glm::vec2 p, size_t vertexLimit, float maxDistance, size_t& segment, float& t, glm::vec2& point) const;
+
+private:
+	void visible(size_t node, size_t firstLeaf, size_t leafSpan, const glm::mat4& model, glm::vec2 viewMin, glm::vec2 viewMax,
+		glm::vec2 hiddenMin, glm::vec2 hiddenMax, float margin, size_t segmentLimit, std::vector<GLint>& firsts, std::vector<GLsizei>& counts) const;
+	void nearest(size_t node, size_t firstLeaf, size_t leafSpan, const glm::vec3* verts, glm::vec2 p, size_t segmentLimit, float& best, size_t& segment, float& t, glm::vec2& point) const;
+
+	static float distance(const Bounds& bounds, glm::vec2 p);
+
+	size_t vertexCount = 0;
+	size_t leafCount = 0;
+	// leaves start at node leafCapacity, a power of two; node 0 is unused
+	size_t leafCapacity = 0;
+	std::vector<Bounds> nodes;
+};
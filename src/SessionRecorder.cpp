@@ -0,0 +1,168 @@
+#include "SessionRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static const char SESSION_MAGIC[8] = { 'H', 'Y', 'P', 'O', 'R', 'E', 'C', '\0' };
+static const uint32_t SESSION_VERSION = 4;
+
+// Events are stored as a fixed 11 byte header followed by size bytes of data
+static const size_t EVENT_HEADER_SIZE = 11;
+
+SessionRecorder::SessionRecorder() : mode(IDLE), currentFrame(0), nextIndex(0), lastFrame(0) {
+}
+
+SessionRecorder::~SessionRecorder() {
+	if (recording()) {
+		finish(nullptr);
+	}
+}
+
+bool SessionRecorder::startRecording(const char* path, int width, int height) {
+	out.open(path, std::ios::binary);
+	if (!out) {
+		return false;
+	}
+	int32_t size[2] = { width, height };
+	out.write(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+	out.write((const char*)&SESSION_VERSION, sizeof(SESSION_VERSION));
+	out.write((const char*)size, sizeof(size));
+
+	mode = RECORDING;
+	currentFrame = 0;
+	start = std::chrono::steady_clock::now();
+	return (bool)out;
+}
+
+bool SessionRecorder::startReplay(const char* path, int& width, int& height) {
+	std::ifstream in(path, std::ios::binary);
+	char magic[8];
+	uint32_t version;
+	int32_t size[2];
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, SESSION_MAGIC, sizeof(magic)) != 0
+		|| !in.read((char*)&version, sizeof(version)) || version != SESSION_VERSION
+		|| !in.read((char*)size, sizeof(size))) {
+		std::cerr << path << " is not a session recording" << std::endl;
+		return false;
+	}
+	width = size[0];
+	height = size[1];
+
+	events.clear();
+	lastFrame = 0;
+	uint8_t header[EVENT_HEADER_SIZE];
+	while (in.read((char*)header, sizeof(header))) {
+		SessionEvent event;
+		memcpy(&event.frame, header, 4);
+		memcpy(&event.micros, header + 4, 4);
+		event.type = header[8];
+		event.id = header[9];
+		event.size = header[10];
+		if (event.size > sizeof(event.data) || !in.read((char*)event.data, event.size)) {
+			std::cerr << path << " is truncated" << std::endl;
+			return false;
+		}
+		events.push_back(event);
+		lastFrame = event.frame;
+		if (event.type == SessionEvent::END) {
+			break;
+		}
+	}
+
+	mode = REPLAYING;
+	currentFrame = 0;
+	nextIndex = 0;
+	frameTimes.clear();
+	frameHashes.clear();
+	return true;
+}
+
+void SessionRecorder::beginFrame() {
+	currentFrame++;
+	// escape exits without unwinding, so don't leave events sitting in the stream buffer
+	if (recording()) {
+		out.flush();
+	}
+}
+
+void SessionRecorder::record(SessionEvent::Type type, uint8_t id, const void* data, size_t size) {
+	if (!recording()) {
+		return;
+	}
+	SessionEvent event;
+	// edits made in the UI while drawing frame N are only acted on in frame N + 1
+	event.frame = currentFrame + (type == SessionEvent::PARAM || type == SessionEvent::ACTION || type == SessionEvent::EXPRESSION ? 1 : 0);
+	event.micros = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	event.type = type;
+	event.id = id;
+	event.size = (uint8_t)std::min(size, sizeof(event.data));
+	if (event.size > 0) {
+		memcpy(event.data, data, event.size);
+	}
+	writeEvent(event);
+}
+
+void SessionRecorder::writeEvent(const SessionEvent& event) {
+	uint8_t header[EVENT_HEADER_SIZE];
+	memcpy(header, &event.frame, 4);
+	memcpy(header + 4, &event.micros, 4);
+	header[8] = event.type;
+	header[9] = event.id;
+	header[10] = event.size;
+	out.write((const char*)header, sizeof(header));
+	out.write((const char*)event.data, event.size);
+}
+
+bool SessionRecorder::nextEvent(SessionEvent& event) {
+	if (!replaying() || nextIndex >= events.size() || events[nextIndex].frame > currentFrame) {
+		return false;
+	}
+	event = events[nextIndex++];
+	return true;
+}
+
+bool SessionRecorder::finished() const {
+	return replaying() && currentFrame >= lastFrame;
+}
+
+void SessionRecorder::endFrame(double seconds, uint64_t geometryHash) {
+	if (replaying()) {
+		frameTimes.push_back(seconds);
+		frameHashes.push_back(geometryHash);
+	}
+}
+
+bool SessionRecorder::finish(const char* reportPath) {
+	if (recording()) {
+		record(SessionEvent::END, 0, nullptr, 0);
+		out.close();
+		mode = IDLE;
+		return !out.fail();
+	}
+	if (!replaying() || reportPath == nullptr) {
+		return false;
+	}
+	mode = IDLE;
+
+	FILE* report = fopen(reportPath, "w");
+	if (report == nullptr) {
+		std::cerr << "Could not open " << reportPath << std::endl;
+		return false;
+	}
+
+	std::vector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	if (!sorted.empty()) {
+		fprintf(report, "frames %zu\nmedian_ms %.3f\np99_ms %.3f\nmax_ms %.3f\nfinal_geometry %016llx\n\n",
+			sorted.size(), sorted[sorted.size() / 2] * 1e3, sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)] * 1e3,
+			sorted.back() * 1e3, (unsigned long long)frameHashes.back());
+	}
+	// the per-frame geometry hashes let two replays be diffed to find where they diverge
+	fprintf(report, "frame ms geometry\n");
+	for (size_t i = 0; i < frameTimes.size(); i++) {
+		fprintf(report, "%zu %.3f %016llx\n", i + 1, frameTimes[i] * 1e3, (unsigned long long)frameHashes[i]);
+	}
+	return fclose(report) == 0;
+}
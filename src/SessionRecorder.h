@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// One recorded input or parameter edit, applied at the start of the frame it happened in
+struct SessionEvent {
+	enum Type : uint8_t {
+		PARAM,   // id is a Program::ParamId, data holds the new value
+		ACTION,  // id is a Program::SessionAction
+		CLICK,   // data holds the cursor position as two floats
+		RESIZE,  // data holds the window size as two int32s
+		STROKE,  // id 0: data holds a freehand stroke position as two floats, id 1: the stroke ended
+		CAMERA,  // id is a Program::CameraChange, data holds its arguments as floats
+		EXPRESSION, // id 0 / 1: data holds the next piece of the custom x / y text, id 2: the text is complete,
+		            // id 3: data holds a custom parameter's index as an int32 and its value as a float
+		END      // last frame of the session
+	};
+
+	uint32_t frame;
+	// since the session started, for reference only; replays run on frame numbers
+	uint32_t micros;
+	uint8_t type;
+	uint8_t id;
+	uint8_t size;
+	uint8_t data[16];
+};
+
+// Records everything that changes Program state into a compact binary log, or plays such a log back.
+// Replays step frame by frame with a fixed clock instead of wall time, so the same log always
+// produces the same geometry, and they collect per-frame timings for a report.
+class SessionRecorder {
+
+public:
+	SessionRecorder();
+	~SessionRecorder();
+
+	bool startRecording(const char* path, int width, int height);
+	// width and height receive the window size the session was recorded with
+	bool startReplay(const char* path, int& width, int& height);
+
+	bool recording() const { return mode == RECORDING; }
+	bool replaying() const { return mode == REPLAYING; }
+	uint32_t frame() const { return currentFrame; }
+
+	// Call once at the start of every frame
+	void beginFrame();
+	void record(SessionEvent::Type type, uint8_t id, const void* data, size_t size);
+	// Replay only: hands out this frame's events one at a time
+	bool nextEvent(SessionEvent& event);
+	// Replay only: true once every frame of the log has run
+	bool finished() const;
+	// Replay only: time the frame took and a checksum of the geometry it produced
+	void endFrame(double seconds, uint64_t geometryHash);
+
+	// Ends a recording, or writes the frame time report of a replay
+	bool finish(const char* reportPath);
+
+private:
+	enum Mode {
+		IDLE,
+		RECORDING,
+		REPLAYING
+	};
+
+	void writeEvent(const SessionEvent& event);
+
+	Mode mode;
+	uint32_t currentFrame;
+	std::chrono::steady_clock::time_point start;
+
+	std::ofstream out;
+
+	std::vector<SessionEvent> events;
+	size_t nextIndex;
+	uint32_t lastFrame;
+	std::vector<double> frameTimes;
+	std::vector<uint64_t> frameHashes;
+};
@@ -152,6 +152,68 @@ GLuint ShaderTools::compileShaders(const char* vertexFilename, const char* geome
 	return program;
 }
 
+GLuint ShaderTools::compileComputeShader(const char* computeFilename) {
+	return compileComputeShader(computeFilename, std::string());
+}
+
+GLuint ShaderTools::compileComputeShader(const char* computeFilename, const std::string& appended) {
+	const GLchar * compute_shader_source [] = {loadshader(computeFilename), appended.c_str()};
+	if (compute_shader_source[0] == NULL) {
+		fprintf(stderr, "Could not read compute shader %s\n", computeFilename);
+		return 0;
+	}
+
+	// Create and compile the compute shader, the strings are compiled as if they were one
+	GLuint compute_shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(compute_shader, 2, compute_shader_source, NULL);
+	glCompileShader(compute_shader);
+
+	GLint status;
+	glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &status);
+
+	if (status == GL_FALSE) {
+		GLint infoLogLength;
+		glGetShaderiv(compute_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+		GLchar* strInfoLog = new GLchar[infoLogLength + 1];
+		glGetShaderInfoLog(compute_shader, infoLogLength, NULL, strInfoLog);
+
+		fprintf(stderr, "Compilation error in shader compute_shader: %s\n", strInfoLog);
+		delete[] strInfoLog;
+
+		glDeleteShader(compute_shader);
+		unloadshader((GLchar**) compute_shader_source);
+		return 0;
+	}
+
+	// Create program, attach the shader to it, and link it
+	GLuint program = glCreateProgram();
+	glAttachShader(program, compute_shader);
+	glLinkProgram(program);
+
+	// Delete the shader as the program has it now
+	glDeleteShader(compute_shader);
+	unloadshader((GLchar**) compute_shader_source);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+	if (status == GL_FALSE) {
+		GLint infoLogLength;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+		GLchar* strInfoLog = new GLchar[infoLogLength + 1];
+		glGetProgramInfoLog(program, infoLogLength, NULL, strInfoLog);
+
+		fprintf(stderr, "Link error in compute program: %s\n", strInfoLog);
+		delete[] strInfoLog;
+
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
 unsigned long ShaderTools::getFileLength(std::ifstream& file) {
 	if (!file.good()) return 0;
 
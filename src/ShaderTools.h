@@ -3,6 +3,7 @@
 #include <GL/glew.h>
 #include <iostream>
 #include <fstream>
+#include <string>
 
 // Class modified from code provided by Allan Rocha for CPSC 591
 class ShaderTools {
@@ -10,6 +11,10 @@ class ShaderTools {
 public:
 	static GLuint compileShaders(const char* vertexFilename, const char* fragmentFilename);
 	static GLuint compileShaders(const char* vertexFilename, const char* geometryFilename, const char* fragmentFilename);
+	// Returns 0 if the shader doesn't compile or link, so callers can fall back to the CPU
+	static GLuint compileComputeShader(const char* computeFilename);
+	// The same with appended compiled after the file's contents, e.g. generated functions the file only declares
+	static GLuint compileComputeShader(const char* computeFilename, const std::string& appended);
 
 private:
 	static unsigned long getFileLength(std::ifstream& file);
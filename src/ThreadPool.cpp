@@ -0,0 +1,141 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+ThreadPool::ThreadPool(int workers) : queued(0), stopping(false) {
+	unsigned int threads = (unsigned int)workers;
+	if (workers < 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		threads = cores > 1 ? cores - 1 : 0;
+	}
+
+	for (unsigned int i = 0; i < threads; i++) {
+		queues.push_back(std::unique_ptr<Queue>(new Queue));
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		this->threads.push_back(std::thread(&ThreadPool::run, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& t : threads) {
+		t.join();
+	}
+}
+
+unsigned int ThreadPool::concurrency() const {
+	return (unsigned int)threads.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+	if (count == 0) {
+		return;
+	}
+	if (grain == 0) {
+		grain = 1;
+	}
+	size_t chunks = (count + grain - 1) / grain;
+	if (chunks == 1 || queues.empty()) {
+		fn(0, count);
+		return;
+	}
+
+	Job job;
+	job.fn = &fn;
+	job.remaining = chunks;
+
+	// hand each worker a contiguous run of chunks so it walks memory in order
+	size_t queueCount = queues.size();
+	for (size_t q = 0; q < queueCount; q++) {
+		size_t firstChunk = chunks * q / queueCount;
+		size_t lastChunk = chunks * (q + 1) / queueCount;
+		if (firstChunk == lastChunk) {
+			continue;
+		}
+		std::lock_guard<std::mutex> lock(queues[q]->mutex);
+		for (size_t c = firstChunk; c < lastChunk; c++) {
+			Task task;
+			task.job = &job;
+			task.begin = c * grain;
+			task.end = (c + 1) * grain < count ? (c + 1) * grain : count;
+			queues[q]->tasks.push_back(task);
+		}
+		queued += lastChunk - firstChunk;
+	}
+	{
+		// taking the lock orders the wakeup after any worker that is just about to sleep
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+
+	// help out until our own job has finished
+	unsigned int start = 0;
+	while (job.remaining > 0) {
+		Task task;
+		if (steal(start, task)) {
+			execute(task);
+		}
+		else {
+			std::this_thread::yield();
+		}
+		start = (start + 1) % (unsigned int)queueCount;
+	}
+}
+
+void ThreadPool::run(unsigned int index) {
+	PROFILE_THREAD("pool worker");
+	while (true) {
+		Task task;
+		if (pop(index, task) || steal(index + 1, task)) {
+			execute(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return stopping || queued > 0; });
+		if (stopping) {
+			return;
+		}
+	}
+}
+
+// Takes the next task from the front of a worker's own queue
+bool ThreadPool::pop(unsigned int index, Task& task) {
+	Queue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty()) {
+		return false;
+	}
+	task = queue.tasks.front();
+	queue.tasks.pop_front();
+	queued--;
+	return true;
+}
+
+// Takes a task from the back of any queue, starting the search at queue start
+bool ThreadPool::steal(unsigned int start, Task& task) {
+	size_t queueCount = queues.size();
+	for (size_t i = 0; i < queueCount; i++) {
+		Queue& queue = *queues[(start + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) {
+			continue;
+		}
+		task = queue.tasks.back();
+		queue.tasks.pop_back();
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::execute(const Task& task) {
+	PROFILE_ZONE("poolTask");
+	(*task.job->fn)(task.begin, task.end);
+	task.job->remaining--;
+}
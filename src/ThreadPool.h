@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for splitting index ranges across cores.
+// Each worker owns a deque of tasks; it takes from the front of its own and steals from the back of the others,
+// so neighbouring chunks tend to stay on the same core until someone runs dry.
+class ThreadPool {
+
+public:
+	// workers < 0 picks one worker per core, not counting the thread that calls parallelFor
+	explicit ThreadPool(int workers = -1);
+	~ThreadPool();
+
+	// workers plus the calling thread, which always helps out
+	unsigned int concurrency() const;
+
+	// Calls fn(begin, end) on disjoint chunks of at most grain indices covering [0, count) and returns once all are done.
+	// Safe to call from several threads at once; small ranges run inline on the caller.
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+private:
+	struct Job {
+		const std::function<void(size_t, size_t)>* fn;
+		std::atomic<size_t> remaining;
+	};
+
+	struct Task {
+		Job* job;
+		size_t begin;
+		size_t end;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void run(unsigned int index);
+	bool pop(unsigned int index, Task& task);
+	bool steal(unsigned int start, Task& task);
+	void execute(const Task& task);
+
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Queue>> queues;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<size_t> queued;
+	bool stopping;
+};
@@ -0,0 +1,107 @@
+#include "UploadBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "CurveGenerator.h"
+#include "Scene.h"
+
+UploadBenchmark::UploadBenchmark(GLFWwindow* window, RenderEngine& renderEngine, SceneArena& arena) :
+	window(window), renderEngine(renderEngine), arena(arena) {
+}
+
+bool UploadBenchmark::run(const char* reportPath) {
+	typedef std::chrono::steady_clock Clock;
+	const size_t vertexCounts[] = { 1000, 10000, 100000, 1000000, 10000000 };
+	const int warmupFrames = 3;
+
+	std::ofstream report(reportPath);
+	if (!report) {
+		std::cerr << "Could not open " << reportPath << std::endl;
+		return false;
+	}
+	report << "renderer: " << glGetString(GL_RENDERER) << "\n";
+	report << "version:  " << glGetString(GL_VERSION) << "\n\n";
+
+	char line[256];
+	snprintf(line, sizeof(line), "%-26s %10s %7s %12s %12s %10s\n", "strategy", "vertices", "frames", "upload ms", "frame ms", "GB/s");
+	report << line;
+	std::cout << line;
+
+	CurveParams params;
+	params.outerRadius = 4;
+	params.innerRadius = 1.37f;
+	params.step = 100;
+
+	UploadStrategy previous = renderEngine.getUploadStrategy();
+	Scene scene(arena);
+	std::vector<double> uploadTimes, frameTimes;
+
+	for (int s = 0; s < UPLOAD_STRATEGY_COUNT; s++) {
+		UploadStrategy strategy = (UploadStrategy)s;
+		if (!renderEngine.setUploadStrategy(strategy)) {
+			snprintf(line, sizeof(line), "%-26s not supported by this driver\n", RenderEngine::uploadStrategyName(strategy));
+			report << line;
+			std::cout << line;
+			continue;
+		}
+
+		for (size_t count : vertexCounts) {
+			GeometryHandle curve = scene.create();
+			renderEngine.assignBuffers(scene, curve);
+			VertexArray& verts = scene.verts(curve);
+			verts.resize(count);
+			CurveGenerator::hypocycloid(params, 0, count, verts.data());
+
+			// enough frames for a stable median without spending minutes on the largest sizes
+			int frames = (int)glm::clamp(20000000 / count, (size_t)5, (size_t)120);
+			uploadTimes.clear();
+			frameTimes.clear();
+			// Frames aren't finished one by one, the GPU works behind the CPU as it does in the program. An upload that
+			// has to wait for earlier frames then shows in the upload time, and a frame is from one start to the next.
+			Clock::time_point start = Clock::now();
+			for (int frame = -warmupFrames; frame < frames && !glfwWindowShouldClose(window); frame++) {
+				glfwPollEvents();
+				// touch the data so nothing can tell it is the same upload again
+				verts[0].z = (float)(frame & 1);
+
+				renderEngine.updateBuffers(scene, curve);
+				Clock::time_point uploaded = Clock::now();
+				renderEngine.render(scene, glm::mat4(1.f), glm::vec4(1.f, 1.f, 0.f, 1.f));
+				glfwSwapBuffers(window);
+
+				Clock::time_point end = Clock::now();
+				if (frame >= 0) {
+					uploadTimes.push_back(std::chrono::duration<double>(uploaded - start).count());
+					frameTimes.push_back(std::chrono::duration<double>(end - start).count());
+				}
+				start = end;
+			}
+			glFinish();
+
+			renderEngine.deleteBuffers(scene, curve);
+			scene.destroy(curve);
+			if (uploadTimes.empty()) {
+				break;
+			}
+
+			std::sort(uploadTimes.begin(), uploadTimes.end());
+			std::sort(frameTimes.begin(), frameTimes.end());
+			double upload = uploadTimes[uploadTimes.size() / 2];
+			double frame = frameTimes[frameTimes.size() / 2];
+			double bandwidth = upload > 0 ? count * sizeof(glm::vec3) / upload * 1e-9 : 0;
+			snprintf(line, sizeof(line), "%-26s %10zu %7zu %12.3f %12.3f %10.2f\n",
+				RenderEngine::uploadStrategyName(strategy), count, uploadTimes.size(), upload * 1e3, frame * 1e3, bandwidth);
+			report << line;
+			std::cout << line;
+		}
+	}
+
+	renderEngine.setUploadStrategy(previous);
+	report.flush();
+	return (bool)report;
+}
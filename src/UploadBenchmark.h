@@ -0,0 +1,24 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "RenderEngine.h"
+#include "SceneArena.h"
+
+// Times every RenderEngine upload strategy on whatever driver the window got (llvmpipe included).
+// Each case re-uploads one hypocycloid every frame and draws it, reporting the median time spent in
+// updateBuffers, the median time from one frame to the next and the bandwidth the upload call achieved.
+class UploadBenchmark {
+
+public:
+	UploadBenchmark(GLFWwindow* window, RenderEngine& renderEngine, SceneArena& arena);
+
+	// Writes a plain text report, returns false if it couldn't be written
+	bool run(const char* reportPath);
+
+private:
+	GLFWwindow* window;
+	RenderEngine& renderEngine;
+	SceneArena& arena;
+};
@@ -0,0 +1,293 @@
+#include "VectorExporter.h"
+
+#include <cmath>
+#include <cstring>
+
+// PDF objects, in the order they are written
+enum PdfObject {
+	PDF_CATALOG = 1,
+	PDF_PAGES = 2,
+	PDF_PAGE = 3,
+	PDF_CONTENT = 4,
+	PDF_LENGTH = 5
+};
+
+VectorExporter::VectorExporter() : file(nullptr), failed(false), format(SVG), used(0), flushed(0) {
+}
+
+VectorExporter::~VectorExporter() {
+	if (file != nullptr) {
+		fclose(file);
+	}
+}
+
+VectorExporter::Format VectorExporter::formatFromPath(const char* path) {
+	size_t length = strlen(path);
+	if (length >= 4 && strcmp(path + length - 4, ".pdf") == 0) {
+		return PDF;
+	}
+	return SVG;
+}
+
+bool VectorExporter::begin(const char* path, Format format, int width, int height, glm::vec2 worldMin, glm::vec2 worldMax, int resolution) {
+	// e.g. a minimized window, there is no page to map the world onto
+	if (width <= 0 || height <= 0 || !(worldMax.x > worldMin.x && worldMax.y > worldMin.y)) {
+		return false;
+	}
+	file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	this->format = format;
+	failed = false;
+	used = 0;
+	flushed = 0;
+	pageWidth = width;
+	pageHeight = height;
+
+	// SVG has y pointing down, PDF has it pointing up like the world
+	pageScale = glm::vec2(width, height) / (worldMax - worldMin);
+	pageOffset = -worldMin * pageScale;
+	if (format == SVG) {
+		pageScale.y = -pageScale.y;
+		pageOffset.y = height - pageOffset.y;
+	}
+
+	// keep rounding below a tenth of a device pixel
+	if (resolution <= 0) {
+		resolution = width;
+	}
+	decimals = (int)std::ceil(std::log10(10.0 * resolution / width));
+	decimals = decimals < 0 ? 0 : (decimals > 6 ? 6 : decimals);
+	decimalScale = 1;
+	for (int i = 0; i < decimals; i++) {
+		decimalScale *= 10;
+	}
+
+	if (format == SVG) {
+		write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+		writeInteger(width);
+		write("\" height=\"");
+		writeInteger(height);
+		write("\" viewBox=\"0 0 ");
+		writeInteger(width);
+		write(" ");
+		writeInteger(height);
+		write("\">\n");
+	}
+	else {
+		write("%PDF-1.4\n");
+		beginObject(PDF_CATALOG);
+		write("<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+		beginObject(PDF_PAGES);
+		write("<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+		beginObject(PDF_PAGE);
+		write("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 ");
+		writeInteger(width);
+		write(" ");
+		writeInteger(height);
+		write("] /Contents 4 0 R /Resources << >> >>\nendobj\n");
+		// the length isn't known until the stream is done, so it goes into its own object afterwards
+		beginObject(PDF_CONTENT);
+		write("<< /Length 5 0 R >>\nstream\n");
+		streamStart = flushed + used;
+		write("1 J 1 j 1 w\n");
+	}
+	return true;
+}
+
+void VectorExporter::beginPath(const glm::mat4& model, glm::vec4 color) {
+	this->model = model;
+	pathPoints = 0;
+	pathEmpty = true;
+
+	if (format == SVG) {
+		char stroke[64];
+		snprintf(stroke, sizeof(stroke), "#%02x%02x%02x\" stroke-opacity=\"%.3g",
+			(int)(glm::clamp(color.r, 0.f, 1.f) * 255), (int)(glm::clamp(color.g, 0.f, 1.f) * 255),
+			(int)(glm::clamp(color.b, 0.f, 1.f) * 255), glm::clamp(color.a, 0.f, 1.f));
+		write("<path fill=\"none\" stroke-linejoin=\"round\" stroke=\"");
+		write(stroke);
+		write("\" d=\"");
+	}
+	else {
+		char stroke[64];
+		snprintf(stroke, sizeof(stroke), "%.3f %.3f %.3f RG\n", color.r, color.g, color.b);
+		write(stroke);
+	}
+}
+
+void VectorExporter::points(const glm::vec3* verts, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		glm::vec4 world = model * glm::vec4(verts[i], 1.f);
+		glm::vec2 page = glm::vec2(world) * pageScale + pageOffset;
+		double scaledX = (double)page.x * decimalScale;
+		double scaledY = (double)page.y * decimalScale;
+		// e.g. a custom curve outside its domain; the path breaks there and picks up at the next point that has a place
+		if (!(std::fabs(scaledX) < MAX_SCALED) || !(std::fabs(scaledY) < MAX_SCALED)) {
+			pathPoints = 0;
+			continue;
+		}
+		long long x = std::llround(scaledX);
+		long long y = std::llround(scaledY);
+
+		// nothing would change at this precision
+		if (pathPoints != 0 && x == lastX && y == lastY) {
+			continue;
+		}
+
+		if (format == SVG) {
+			// lineto is implied for every pair after the first L
+			write(pathPoints == 0 ? (pathEmpty ? "M" : " M") : (pathPoints == 1 ? " L" : " "));
+		}
+		writeNumber(x);
+		write(" ");
+		writeNumber(y);
+		if (format == PDF) {
+			write(pathPoints == 0 ? " m\n" : " l\n");
+		}
+
+		pathPoints++;
+		pathEmpty = false;
+		lastX = x;
+		lastY = y;
+	}
+}
+
+void VectorExporter::endPath() {
+	if (format == SVG) {
+		write("\"/>\n");
+	}
+	else if (!pathEmpty) {
+		write("S\n");
+	}
+}
+
+bool VectorExporter::end() {
+	if (file == nullptr) {
+		return false;
+	}
+
+	if (format == SVG) {
+		write("</svg>\n");
+	}
+	else {
+		size_t streamLength = flushed + used - streamStart;
+		write("endstream\nendobj\n");
+		beginObject(PDF_LENGTH);
+		writeInteger((long long)streamLength);
+		write("\nendobj\n");
+
+		size_t xref = flushed + used;
+		write("xref\n0 6\n0000000000 65535 f \n");
+		for (int object = 1; object <= PDF_OBJECTS; object++) {
+			char entry[32];
+			snprintf(entry, sizeof(entry), "%010zu 00000 n \n", objectOffsets[object]);
+			write(entry);
+		}
+		write("trailer\n<< /Size 6 /Root 1 0 R >>\nstartxref\n");
+		writeInteger((long long)xref);
+		write("\n%%EOF\n");
+	}
+
+	flush();
+	bool ok = !failed && fclose(file) == 0;
+	file = nullptr;
+	return ok;
+}
+
+void VectorExporter::beginObject(int object) {
+	objectOffsets[object] = flushed + used;
+	writeInteger(object);
+	write(" 0 obj\n");
+}
+
+void VectorExporter::write(const char* data, size_t size) {
+	if (used + size > BUFFER_SIZE) {
+		flush();
+	}
+	if (size > BUFFER_SIZE) {
+		failed |= fwrite(data, 1, size, file) != size;
+		flushed += size;
+		return;
+	}
+	memcpy(buffer + used, data, size);
+	used += size;
+}
+
+void VectorExporter::write(const char* text) {
+	write(text, strlen(text));
+}
+
+void VectorExporter::flush() {
+	if (used == 0) {
+		return;
+	}
+	failed |= fwrite(buffer, 1, used, file) != used;
+	flushed += used;
+	used = 0;
+}
+
+void VectorExporter::writeInteger(long long value) {
+	char digits[24];
+	int length = 0;
+	bool negative = value < 0;
+	unsigned long long magnitude = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+	do {
+		digits[length++] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+
+	char text[24];
+	int n = 0;
+	if (negative) {
+		text[n++] = '-';
+	}
+	while (length > 0) {
+		text[n++] = digits[--length];
+	}
+	write(text, n);
+}
+
+// Writes a coordinate given in units of 10^-decimals, with trailing zeros trimmed
+void VectorExporter::writeNumber(long long value) {
+	if (decimals == 0) {
+		writeInteger(value);
+		return;
+	}
+
+	bool negative = value < 0;
+	unsigned long long magnitude = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+	unsigned long long whole = magnitude / decimalScale;
+	unsigned long long fraction = magnitude % decimalScale;
+
+	char text[48];
+	int n = 0;
+	if (negative && magnitude != 0) {
+		text[n++] = '-';
+	}
+	char digits[24];
+	int length = 0;
+	do {
+		digits[length++] = (char)('0' + whole % 10);
+		whole /= 10;
+	} while (whole != 0);
+	while (length > 0) {
+		text[n++] = digits[--length];
+	}
+
+	if (fraction != 0) {
+		text[n++] = '.';
+		int places = decimals;
+		while (fraction % 10 == 0) {
+			fraction /= 10;
+			places--;
+		}
+		for (int i = places - 1; i >= 0; i--) {
+			text[n + i] = (char)('0' + fraction % 10);
+			fraction /= 10;
+		}
+		n += places;
+	}
+	write(text, n);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdio>
+
+// Streams polylines to SVG path data or a PDF content stream through a fixed size buffer,
+// so exporting a curve never builds the whole document in memory.
+// Coordinates are written with just enough decimals for the target resolution, and points that
+// round to the same output position as the previous one are dropped.
+class VectorExporter {
+
+public:
+	enum Format {
+		SVG,
+		PDF
+	};
+
+	VectorExporter();
+	~VectorExporter();
+
+	// Maps the world rectangle [worldMin, worldMax] onto a width x height page.
+	// resolution is how many device pixels the page width will end up as (e.g. for printing),
+	// which decides how many decimals are needed; 0 means the page width itself.
+	// Returns false for an empty page or world rectangle, or if the file can't be opened.
+	bool begin(const char* path, Format format, int width, int height, glm::vec2 worldMin, glm::vec2 worldMax, int resolution = 0);
+	// Starts a stroked polyline whose points get transformed by model first
+	void beginPath(const glm::mat4& model, glm::vec4 color);
+	// Points that aren't finite, or too far off the page to write, are skipped and break the line in two
+	void points(const glm::vec3* verts, size_t count);
+	void endPath();
+	// Finishes the document and closes the file, returns false if anything failed to write
+	bool end();
+
+	static Format formatFromPath(const char* path);
+
+private:
+	void write(const char* data, size_t size);
+	void write(const char* text);
+	void writeNumber(long long scaled);
+	void writeInteger(long long value);
+	void flush();
+	void beginObject(int object);
+
+	FILE* file;
+	bool failed;
+	Format format;
+
+	static const size_t BUFFER_SIZE = 1 << 16;
+	char buffer[BUFFER_SIZE];
+	size_t used;
+	size_t flushed;
+
+	// world to page transform
+	glm::mat4 model;
+	glm::vec2 pageScale;
+	glm::vec2 pageOffset;
+	int pageWidth;
+	int pageHeight;
+
+	int decimals;
+	long long decimalScale;
+	// scaled coordinates from here on don't fit a long long
+	static constexpr double MAX_SCALED = 9.2e18;
+
+	// in the current piece of the path, and whether any piece has been written
+	size_t pathPoints;
+	bool pathEmpty;
+	long long lastX;
+	long long lastY;
+
+	// PDF bookkeeping: byte offsets of objects for the xref table
+	static const int PDF_OBJECTS = 5;
+	size_t objectOffsets[PDF_OBJECTS + 1];
+	size_t streamStart;
+};
@@ -0,0 +1,76 @@
+#include "VertexArray.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "SceneArena.h"
+
+VertexArray::VertexArray(SceneArena& arena) : arena(&arena), verts(nullptr), count(0), capacity(0), borrowed(false) {
+}
+
+VertexArray::~VertexArray() {
+	if (verts != nullptr && !borrowed) {
+		arena->freeVertices(verts, capacity);
+	}
+}
+
+void VertexArray::swap(VertexArray& other) {
+	std::swap(arena, other.arena);
+	std::swap(verts, other.verts);
+	std::swap(count, other.count);
+	std::swap(capacity, other.capacity);
+	std::swap(borrowed, other.borrowed);
+}
+
+void VertexArray::borrow(const glm::vec3* data, size_t newCount) {
+	if (verts != nullptr && !borrowed) {
+		arena->freeVertices(verts, capacity);
+	}
+	verts = const_cast<glm::vec3*>(data);
+	count = newCount;
+	capacity = 0;
+	borrowed = true;
+}
+
+void VertexArray::clear() {
+	count = 0;
+	if (borrowed) {
+		verts = nullptr;
+		borrowed = false;
+	}
+}
+
+void VertexArray::reserve(size_t newCapacity) {
+	// borrowed vertices are copied out on the first change, whatever the capacity asked for
+	if (borrowed) {
+		newCapacity = std::max(newCapacity, count);
+	}
+	else if (newCapacity <= capacity) {
+		return;
+	}
+
+	glm::vec3* grown = newCapacity > 0 ? arena->allocateVertices(newCapacity) : nullptr;
+	if (verts != nullptr) {
+		memcpy(grown, verts, sizeof(glm::vec3) * count);
+		if (!borrowed) {
+			arena->freeVertices(verts, capacity);
+		}
+	}
+	verts = grown;
+	capacity = newCapacity;
+	borrowed = false;
+}
+
+void VertexArray::resize(size_t newCount) {
+	reserve(newCount);
+	count = newCount;
+}
+
+void VertexArray::push_back(const glm::vec3& v) {
+	// borrowed vertices have no capacity, so they are copied out too
+	if (count >= capacity) {
+		reserve(count + 1);
+	}
+	verts[count++] = v;
+}
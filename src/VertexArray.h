@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+class SceneArena;
+
+// Growable array of vertices whose storage comes from a SceneArena instead of the heap.
+// Unlike std::vector, resize() leaves new vertices uninitialized since they are always generated in place.
+class VertexArray {
+
+public:
+	explicit VertexArray(SceneArena& arena);
+	~VertexArray();
+
+	VertexArray(const VertexArray&) = delete;
+	VertexArray& operator=(const VertexArray&) = delete;
+
+	// O(1) exchange of contents with an array from the same arena
+	void swap(VertexArray& other);
+	// Shows count vertices owned by someone else, e.g. a file mapping, without copying them. They have to outlive
+	// the view and may be read-only, so they must not be written through data(). clear() lets go of them, and
+	// resizing or appending copies them into the arena first.
+	void borrow(const glm::vec3* data, size_t count);
+	bool borrowing() const { return borrowed; }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	glm::vec3* data() { return verts; }
+	const glm::vec3* data() const { return verts; }
+	glm::vec3& operator[](size_t i) { return verts[i]; }
+	const glm::vec3& operator[](size_t i) const { return verts[i]; }
+	glm::vec3* begin() { return verts; }
+	glm::vec3* end() { return verts + count; }
+	const glm::vec3* begin() const { return verts; }
+	const glm::vec3* end() const { return verts + count; }
+
+	void clear();
+	void reserve(size_t newCapacity);
+	void resize(size_t newCount);
+	void push_back(const glm::vec3& v);
+
+private:
+	SceneArena* arena;
+	glm::vec3* verts;
+	size_t count;
+	size_t capacity;
+	bool borrowed;
+};
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "BatchRenderer.h"
+
+static void usage() {
+	std::cerr <<
+		"usage: hypo_batch (--outer MIN:MAX:N --inner MIN:MAX:N | --list FILE) [options]\n"
+		"  --outer MIN:MAX:N   large circle radii to sweep\n"
+		"  --inner MIN:MAX:N   small circle radii to sweep\n"
+		"  --list FILE         one curve per line: R r [cycles step rotation scale]\n"
+		"  --cycles N          default number of cycles (1)\n"
+		"  --step N            default hypocycloid resolution (100)\n"
+		"  --rotation DEG      default rotation (0)\n"
+		"  --scale S           default scale factor (1)\n"
+		"  --size WxH          image size (1024x1024)\n"
+		"  --fit               scale each curve to fill its image\n"
+		"  --out DIR           output directory (.)\n"
+		"  --format FMT        pgm, svg or pdf (pgm)\n"
+		"  --density           pgm of how often the curve crosses each pixel instead of its lines\n"
+		"  --exposure E        contrast of --density images (4)\n"
+		"  --threads N         threads to use, 0 for all cores (0)\n";
+}
+
+int main(int argc, char** argv) {
+	BatchOptions options;
+	BatchJob base;
+	base.params.outerRadius = 4;
+	base.params.innerRadius = 1;
+	base.params.step = 100;
+	base.cycles = 1;
+	base.rotation = 0;
+	base.scale = 1;
+
+	const char* outer = nullptr;
+	const char* inner = nullptr;
+	const char* list = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool takesValue = strcmp(arg, "--fit") != 0 && strcmp(arg, "--density") != 0 && strcmp(arg, "--help") != 0;
+		if (takesValue && value == nullptr) {
+			std::cerr << arg << " needs a value" << std::endl;
+			usage();
+			return 1;
+		}
+
+		if (strcmp(arg, "--outer") == 0) outer = value;
+		else if (strcmp(arg, "--inner") == 0) inner = value;
+		else if (strcmp(arg, "--list") == 0) list = value;
+		else if (strcmp(arg, "--cycles") == 0) base.cycles = atoi(value);
+		else if (strcmp(arg, "--step") == 0) base.params.step = atoi(value);
+		else if (strcmp(arg, "--rotation") == 0) base.rotation = (float)atof(value);
+		else if (strcmp(arg, "--scale") == 0) base.scale = (float)atof(value);
+		else if (strcmp(arg, "--size") == 0) {
+			if (sscanf(value, "%dx%d", &options.width, &options.height) != 2 || options.width < 1 || options.height < 1) {
+				std::cerr << "bad image size " << value << std::endl;
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "--fit") == 0) options.fit = true;
+		else if (strcmp(arg, "--density") == 0) options.density = true;
+		else if (strcmp(arg, "--exposure") == 0) options.exposure = (float)atof(value);
+		else if (strcmp(arg, "--out") == 0) options.outputDirectory = value;
+		else if (strcmp(arg, "--format") == 0) {
+			if (strcmp(value, "pgm") == 0) options.format = BATCH_PGM;
+			else if (strcmp(value, "svg") == 0) options.format = BATCH_SVG;
+			else if (strcmp(value, "pdf") == 0) options.format = BATCH_PDF;
+			else {
+				std::cerr << "unknown format " << value << std::endl;
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "--threads") == 0) options.threads = (unsigned int)atoi(value);
+		else {
+			usage();
+			return strcmp(arg, "--help") == 0 ? 0 : 1;
+		}
+		if (takesValue) {
+			i++;
+		}
+	}
+
+	std::vector<BatchJob> jobs;
+	if (list != nullptr) {
+		if (!BatchRenderer::readList(list, base, jobs)) {
+			std::cerr << "could not read " << list << std::endl;
+			return 1;
+		}
+	}
+	if (outer != nullptr || inner != nullptr) {
+		float outerMin = base.params.outerRadius, outerMax = outerMin, innerMin = base.params.innerRadius, innerMax = innerMin;
+		int outerCount = 1, innerCount = 1;
+		if ((outer != nullptr && !BatchRenderer::parseRange(outer, outerMin, outerMax, outerCount)) ||
+			(inner != nullptr && !BatchRenderer::parseRange(inner, innerMin, innerMax, innerCount))) {
+			std::cerr << "ranges are MIN:MAX:COUNT" << std::endl;
+			return 1;
+		}
+		std::vector<BatchJob> sweep = BatchRenderer::grid(outerMin, outerMax, outerCount, innerMin, innerMax, innerCount, base);
+		jobs.insert(jobs.end(), sweep.begin(), sweep.end());
+	}
+	if (jobs.empty()) {
+		usage();
+		return 1;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(options.outputDirectory, error);
+
+	BatchRenderer renderer(options);
+	auto start = std::chrono::steady_clock::now();
+	size_t failed = renderer.run(jobs);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << jobs.size() - failed << " of " << jobs.size() << " curves rendered in " << seconds << " s ("
+		<< jobs.size() / seconds << " curves/s)" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
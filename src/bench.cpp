@@ -0,0 +1,214 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "Benchmark.h"
+#include "CurveExpression.h"
+#include "CurveGenerator.h"
+#include "DensityMap.h"
+#include "Epicycles.h"
+#include "SegmentBVH.h"
+#include "ThreadPool.h"
+
+static void usage() {
+	std::cerr <<
+		"usage: hypo_bench [options]\n"
+		"  --filter TEXT       only run benchmarks whose name contains TEXT\n"
+		"  --reps N            timed repetitions per benchmark (25)\n"
+		"  --warmup N          untimed runs before timing (3)\n"
+		"  --threads N         threads for the pool variants, 0 for all cores (0)\n"
+		"  --json FILE         write the results as JSON\n"
+		"  --baseline FILE     compare against an earlier --json file\n"
+		"  --threshold PCT     slowdown reported as a regression (10)\n";
+}
+
+// Keeps the compiler from dropping generation whose output is never read
+static volatile float sink;
+
+int main(int argc, char** argv) {
+	BenchmarkOptions options;
+	int threads = 0;
+	const char* json = nullptr;
+	const char* baseline = nullptr;
+	double threshold = 10;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (strcmp(arg, "--help") == 0 || value == nullptr) {
+			usage();
+			return strcmp(arg, "--help") == 0 ? 0 : 1;
+		}
+
+		if (strcmp(arg, "--filter") == 0) options.filter = value;
+		else if (strcmp(arg, "--reps") == 0) options.repetitions = atoi(value);
+		else if (strcmp(arg, "--warmup") == 0) options.warmup = atoi(value);
+		else if (strcmp(arg, "--threads") == 0) threads = atoi(value);
+		else if (strcmp(arg, "--json") == 0) json = value;
+		else if (strcmp(arg, "--baseline") == 0) baseline = value;
+		else if (strcmp(arg, "--threshold") == 0) threshold = atof(value);
+		else {
+			usage();
+			return 1;
+		}
+		i++;
+	}
+
+	ThreadPool pool(threads > 0 ? threads - 1 : -1);
+	Benchmark benchmark(options);
+
+	// one output buffer big enough for every case, allocated and touched before timing
+	const size_t sizes[] = { 1000, 100000, 10000000 };
+	std::vector<glm::vec3> out(sizes[2] + 1, glm::vec3(0.f));
+
+	CurveParams params;
+	params.outerRadius = 4;
+	params.innerRadius = 1.37f;
+	params.step = 100;
+
+	// the culling and picking structure needs a real curve that the other cases don't overwrite
+	std::vector<glm::vec3> curve(sizes[2]);
+	CurveGenerator::hypocycloid(pool, params, curve.size(), curve.data());
+	std::vector<SegmentBVH> trees(sizeof(sizes) / sizeof(sizes[0]));
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+
+	CurveExpression expression;
+	expression.compile("(R - r) * cos(t) + r * cos((R - r) / r / r * t)", "(R - r) * sin(t) - r * sin((R - r) / r / r * t)");
+	const float expressionParameters[2] = { params.outerRadius, params.innerRadius };
+
+	// a 1024x1024 window showing the default +-10 units
+	DensityMap density;
+	density.resize(1024, 1024);
+	glm::dmat3 toPixels = glm::dmat3(51.2, 0.0, 0.0, 0.0, -51.2, 0.0, 512.0, 512.0, 1.0);
+
+	for (size_t s = 0; s < trees.size(); s++) {
+		size_t count = sizes[s];
+		std::string size = std::to_string(count);
+		benchmark.add("hypocycloid/serial/" + size, count, [&, count]() {
+			CurveGenerator::hypocycloid(params, 0, count, out.data());
+			sink = out[count - 1].x;
+		});
+		benchmark.add("hypocycloid/pool/" + size, count, [&, count]() {
+			CurveGenerator::hypocycloid(pool, params, count, out.data());
+			sink = out[count - 1].x;
+		});
+		// the same curve typed in as a custom curve, to compare the interpreter against the kernel it stands in for
+		benchmark.add("expression/serial/" + size, count, [&, count]() {
+			expression.evaluate(expressionParameters, 0.0, 1.0 / params.step, 0, count, out.data());
+			sink = out[count - 1].x;
+		});
+		benchmark.add("expression/pool/" + size, count, [&, count]() {
+			expression.evaluate(pool, expressionParameters, 0.0, 1.0 / params.step, count, out.data());
+			sink = out[count - 1].x;
+		});
+
+		// the detail that gives about the same number of samples
+		int detail = (int)std::floor((count - 1) / (2 * 3.14159265358979323846));
+		size_t circleCount = CurveGenerator::circleSampleCount(detail);
+		benchmark.add("circle/serial/" + size, circleCount, [&, detail, circleCount]() {
+			CurveGenerator::circle(glm::vec3(0.f), 4.f, detail, 0, circleCount, out.data());
+			sink = out[circleCount - 1].x;
+		});
+		benchmark.add("circle/pool/" + size, circleCount, [&, detail, circleCount]() {
+			CurveGenerator::circle(pool, glm::vec3(0.f), 4.f, detail, out.data());
+			sink = out[circleCount - 1].x;
+		});
+
+		float uStep = 1.f / (float)(count - 1);
+		size_t quadraticCount = glm::min(CurveGenerator::quadraticSampleCount(uStep), out.size());
+		glm::vec3 a(-3.f, 1.f, 0.f), b(2.f, -4.f, 0.f), c(1.5f, 2.5f, 0.f);
+		benchmark.add("quadratic/serial/" + size, quadraticCount, [&, uStep, quadraticCount]() {
+			CurveGenerator::quadratic(a, b, c, uStep, 0, quadraticCount, out.data());
+			sink = out[quadraticCount - 1].x;
+		});
+		if (quadraticCount == CurveGenerator::quadraticSampleCount(uStep)) {
+			benchmark.add("quadratic/pool/" + size, quadraticCount, [&, uStep, quadraticCount]() {
+				CurveGenerator::quadratic(pool, a, b, c, uStep, out.data());
+				sink = out[quadraticCount - 1].x;
+			});
+		}
+
+		trees[s].build(pool, curve.data(), count);
+		benchmark.add("bvh/build/" + size, count, [&, s, count]() {
+			trees[s].build(pool, curve.data(), count);
+			sink = (float)trees[s].size();
+		});
+		// a view a tenth the size of the curve, about what zooming in on part of it looks like
+		benchmark.add("bvh/visible/" + size, 1, [&, s, count]() {
+			firsts.clear();
+			counts.clear();
+			trees[s].visibleRanges(glm::mat4(1.f), glm::vec2(2.f, -0.5f), glm::vec2(3.f, 0.5f), glm::vec2(1.f), glm::vec2(0.f),
+				0.f, count, firsts, counts);
+			sink = (float)firsts.size();
+		});
+		benchmark.add("bvh/nearest/" + size, 1, [&, s, count]() {
+			size_t segment;
+			float t;
+			glm::vec2 point;
+			trees[s].nearest(curve.data(), glm::vec2(1.7f, 0.9f), count, 1e30f, segment, t, point);
+			sink = point.x;
+		});
+
+		// streamed from the generator, so this is generation plus binning with nothing stored
+		benchmark.add("density/serial/" + size, count, [&, count]() {
+			density.accumulate(params, toPixels, 0, count);
+		});
+		benchmark.add("density/pool/" + size, count, [&, count]() {
+			density.accumulate(pool, params, toPixels, 0, count);
+		});
+	}
+
+	// a chain fitted to points spread along the curve above, so every term has something to fit
+	std::vector<glm::vec2> path(Epicycles::DEFAULT_FIT_SAMPLES);
+	for (size_t i = 0; i < path.size(); i++) {
+		path[i] = glm::vec2(curve[i * curve.size() / path.size()]);
+	}
+	Epicycles epicycles;
+	benchmark.add("epicycles/fit/" + std::to_string(path.size()), path.size(), [&]() {
+		epicycles.fit(path.data(), path.size(), Epicycles::DEFAULT_FIT_SAMPLES);
+		sink = epicycles.radius(0);
+	});
+	epicycles.fit(path.data(), path.size(), Epicycles::DEFAULT_FIT_SAMPLES);
+	const size_t epicycleSamples = 4097;
+	for (size_t terms : { (size_t)64, (size_t)1024, Epicycles::DEFAULT_FIT_SAMPLES }) {
+		// items are term evaluations, samples times terms
+		std::string size = std::to_string(terms);
+		benchmark.add("epicycles/serial/" + size, epicycleSamples * terms, [&, terms]() {
+			epicycles.evaluate(terms, 0.0, 2 * 3.14159265358979323846 / (epicycleSamples - 1), epicycleSamples, out.data());
+			sink = out[epicycleSamples - 1].x;
+		});
+		benchmark.add("epicycles/pool/" + size, epicycleSamples * terms, [&, terms]() {
+			epicycles.evaluate(pool, terms, epicycleSamples, out.data());
+			sink = out[epicycleSamples - 1].x;
+		});
+	}
+
+	const std::vector<BenchmarkResult>& results = benchmark.run();
+	if (results.empty()) {
+		std::cerr << "no benchmark matches \"" << options.filter << "\"" << std::endl;
+		return 1;
+	}
+
+	if (json != nullptr) {
+		std::ofstream file(json);
+		benchmark.writeJSON(file);
+		if (!file) {
+			std::cerr << "could not write " << json << std::endl;
+			return 1;
+		}
+	}
+
+	if (baseline != nullptr) {
+		std::vector<BenchmarkResult> old;
+		if (!Benchmark::readJSON(baseline, old)) {
+			std::cerr << "could not read " << baseline << std::endl;
+			return 1;
+		}
+		size_t regressions = benchmark.compare(old, threshold / 100, std::cout);
+		return regressions > 0 ? 2 : 0;
+	}
+	return 0;
+}
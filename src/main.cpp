@@ -1,7 +1,23 @@
 #include "Program.h"
 
-int main() {
+#include <cstring>
+
+int main(int argc, char** argv) {
 	Program p = Program();
+	// a1 --upload-benchmark [report file] compares the ways of uploading vertices instead of opening the UI
+	if (argc > 1 && strcmp(argv[1], "--upload-benchmark") == 0) {
+		p.benchmarkUploads(argc > 2 ? argv[2] : "upload_benchmark.txt");
+		return 0;
+	}
+	// a1 --record FILE logs the session, a1 --replay FILE [report file] plays it back as fast as possible
+	if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+		p.record(argv[2]);
+		return 0;
+	}
+	if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+		p.replay(argv[2], argc > 3 ? argv[3] : "replay_report.txt");
+		return 0;
+	}
 	p.start();
 	return 0;
 }